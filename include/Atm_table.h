@@ -0,0 +1,72 @@
+#ifndef A_T
+#define A_T
+#include <vector>
+#include <cstddef>
+
+// Equidistant lookup tables for the atmospheric profile functions of
+// atmprof.h (rhofx, thickx, refidx, heighx) or of the CORSIKA 5-layer
+// parametrization in mc_atmprof.h (rhofc, thickc, refim1c, heighc).
+// Heights in cm a.s.l., thickness in g/cm^2, as in those functions.
+// Density, thickness and n-1 are tabulated in height, height is tabulated
+// in log(thickness). Outside the tabulated range the reference function is used.
+// The default range stops below 100 km, where the 5-layer density jumps.
+// The density of the 5-layer parametrization is also discontinuous at the
+// lower layer boundaries, which dominates max_rel_err for that source.
+class Atm_table
+{
+    public:
+    int source;         // 0: rhofx/thickx/refidx/heighx, 1: 5-layer parametrization
+    double hmin, hmax;
+    double dh, dhi;
+    int nh;
+    std::vector<double> rho;
+    std::vector<double> thick;
+    std::vector<double> refm1;
+    double ltmin, ltmax; // log(thickness) range of the inverse table
+    double dlt, dlti;
+    int nt;
+    std::vector<double> height;
+    double max_rel_err[4];  // from validate(): rho, thick, n-1, height
+
+    Atm_table();
+    ~Atm_table();
+    void clear();
+    int build(int src, double h_low = 0., double h_high = 99e5, double step = 1e3);
+    void validate();
+
+    double rhof(double h) const;
+    double thickf(double h) const;
+    double refidf(double h) const;
+    double heighf(double t) const;
+    void rhof(const double* h, double* out, size_t n) const;
+    void thickf(const double* h, double* out, size_t n) const;
+    void refidf(const double* h, double* out, size_t n) const;
+    void heighf(const double* t, double* out, size_t n) const;
+
+    double ref_rho(double h) const;
+    double ref_thick(double h) const;
+    double ref_refm1(double h) const;
+    double ref_height(double t) const;
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef A_TR
+#define A_TR
+#include <vector>
+#include <cstddef>
+#include "mc_tel.h"
+
+// Atmospheric transmission from a sim_telarray/CORSIKA extinction table
+// (atm_trans_*.dat: "# H2= <obs. level>, H1= <emission heights [km]>" followed
+// by lines of wavelength [nm] and vertical optical depth for each H1).
+// For each airmass the transmission exp(-airmass*tau) is tabulated on a
+// regular (emission height x wavelength) grid in single precision and looked
+// up with bilinear interpolation. Bunches with lambda = 0 get the transmission
+// averaged over a lambda^-2 Cherenkov spectrum.
+class Atm_trans
+{
+    public:
+    double obslev;                // H2 [km]
+    std::vector<double> h_km;     // H1 levels of the file
+    std::vector<double> wl_nm;
+    std::vector<double> tau;      // [iwl * h_km.size() + ih]
+
+    // grid of the per-airmass tables
+    int nz, nwl;
+    double z0, dzi;               // emission height [cm], inverse step
+    double wl0, dwli;             // wavelength [nm], inverse step
+    double wl_min, wl_max;        // range of the lambda = 0 average
+
+    Atm_trans();
+    ~Atm_trans();
+    void clear();
+    int read(const char* fname);
+    const std::vector<float>* table(double airmass);
+    double transmission(double zem, double lambda, double airmass);
+    void transmission(const struct bunch* bunches, int nbunches, double airmass, float* w);
+
+    private:
+    double vertical_tau(double h, double lambda) const;
+    // a few recently used airmasses; last column of each row is the lambda = 0 average
+    std::vector<double> cache_airmass;
+    std::vector<std::vector<float> > cache_table;
+    size_t cache_next;
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
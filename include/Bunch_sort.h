@@ -0,0 +1,45 @@
+#ifndef B_S
+#define B_S
+#include <vector>
+#include <cstdint>
+#include "mc_tel.h"
+
+// Sorts the bunches of one telescope by arrival time (ctime), in place and
+// stable. LSD radix sort of the float keys mapped to ordered unsigned ints,
+// 4 passes of 8 bits over (key, index) pairs, skipping the passes in which all
+// keys share the byte; the bunches are then moved once. The buffers are kept
+// between calls, so one Bunch_sort is reused for all telescopes.
+class Bunch_sort
+{
+    public:
+    Bunch_sort();
+    ~Bunch_sort();
+    void sort_time(struct bunch* bunches, int nbunches);
+
+    private:
+    std::vector<uint32_t> key, key2;
+    std::vector<uint32_t> idx, idx2;
+    std::vector<struct bunch> tmp;
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
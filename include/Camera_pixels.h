@@ -0,0 +1,88 @@
+#ifndef C_P
+#define C_P
+#include <vector>
+#include <cstddef>
+#include "mc_tel.h"
+
+// Pixel shapes numbered as Pix_Type::pixel_shape in mc_aux.h:
+// 0: circular, 1: hexagonal with flat sides at x = +-half_size,
+// 2: square, 3: hexagonal with flat sides at y = +-half_size.
+// Positions are in the focal plane, in units of flen (flen = 1 gives
+// the tangent-plane offset in radians).
+class Camera_pixels
+{
+    public:
+    int npix;
+    double flen;
+    std::vector<double> xpix;
+    std::vector<double> ypix;
+    std::vector<int> shape;
+    std::vector<double> half_size;  // half flat-to-flat size, radius if circular
+
+    // rectangular grid for pixel search, as PM_Grid in mc_aux.h but with
+    // the pixel lists of all grid elements kept in one array
+    double x_low, x_high;
+    double y_low, y_high;
+    double dxm1, dym1;
+    int nx, ny;
+    std::vector<int> grid_first;    // pixels of element i are grid_pix[grid_first[i]..grid_first[i+1]-1]
+    std::vector<int> grid_pix;
+
+    Camera_pixels();
+    ~Camera_pixels();
+    void clear();
+    int add_pixel(double x, double y, int pixel_shape, double hs);
+    void set_hex_camera(int nrings, double pixel_size, int pixel_shape = 1);
+    void set_square_camera(int nrows, double pixel_size);
+    void setup_grid();
+    int find_pixel(double x, double y) const;
+    void fill_image(const struct bunch* bunches, int nbunches, double az, double alt, double* image) const;
+    static void fill_images(int ntel, const Camera_pixels* const* cams, const struct bunch* const* bunches,
+                            const int* nbunches, double az, double alt, double* const* images);
+
+#ifdef _MC_AUX_LOADED
+    // take over the pixels of a sim_telarray camera, flen in cm like the pixel positions
+    void set(const struct pm_camera* cam, double focal_length)
+    {
+        clear();
+        flen = focal_length;
+        for(int i = 0; i < cam->pixels; i++)
+        {
+            if(cam->pm_list != NULL)
+            {
+                const struct Pix_Type* pt = &cam->pixtype[cam->pm_list[i].pix_type];
+                add_pixel(cam->pm_list[i].x, cam->pm_list[i].y, pt->pixel_shape,
+                          pt->pixel_shape == 0 ? pt->r : pt->half_size);
+            }
+            else
+            {
+                add_pixel(cam->pixel_x_pos[i], cam->pixel_y_pos[i], cam->camera_type == 2 ? 2 : 1,
+                          0.5 * cam->pixel_size);
+            }
+        }
+        setup_grid();
+    }
+#endif
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
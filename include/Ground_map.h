@@ -0,0 +1,56 @@
+#ifndef G_M
+#define G_M
+#include <vector>
+#include <cstddef>
+#include "mc_tel.h"
+
+class TH2F;
+
+// Photons of the bunches on a square grid in the ground plane, [-size, size] m
+// in x and y around the shower core. fill() bins the bunches of one telescope
+// into per-thread grids (bunches in parallel with OpenMP), merge() adds these
+// into the map, e.g. at the end of each event, and only walks the touched rows.
+// Bin (ix, iy) is grid[iy * nbins + ix], the same cell as TH2F bin (ix+1, iy+1).
+class Ground_map
+{
+    public:
+    int nbins;
+    double size;
+    double dxi;                   // bins per m
+    std::vector<float> grid;      // merged photons
+
+    Ground_map();
+    ~Ground_map();
+    void set(int n, double s);
+    void clear();
+    void fill(const struct bunch* bunches, int nbunches, double x0, double y0);
+    void merge();
+    void sparse(std::vector<int>& bins, std::vector<float>& photons) const;
+    TH2F* hist(const char* name, const char* title) const;
+
+    private:
+    std::vector<std::vector<float> > tgrid;   // per thread
+    std::vector<std::vector<char> > trows;    // rows touched per thread
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef H_P
+#define H_P
+#include "Camera_pixels.h"
+
+// Second-moment image parameters in the units of the camera (flen units),
+// angles in rad. disp is 1-width/length as used by shower_geometric_reconstruction.
+class Hillas_parameters
+{
+    public:
+    double size;
+    double cog_x;
+    double cog_y;
+    double length;
+    double width;
+    double psi;
+    double disp;
+    int npix;       // pixels above threshold
+
+    Hillas_parameters();
+    ~Hillas_parameters();
+    void clear();
+    int compute(const Camera_pixels* cam, const double* image, double threshold = 0.);
+    static void compute_all(int nimg, const Camera_pixels* const* cams, const double* const* images,
+                            Hillas_parameters* hillas, double threshold = 0.);
+    static int reconstruct(int ntel, const Hillas_parameters* hillas, const Camera_pixels* const* cams,
+                           const double* xtel, const double* ytel, const double* ztel,
+                           double az, double alt, double min_size,
+                           double* shower_az, double* shower_alt, double* xc, double* yc);
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef H_D
+#define H_D
+#include <string>
+#include <vector>
+
+// Histogram definitions for Draw, one per line of a text file ('#' starts a comment):
+//   <name> [tree=<tree>] x=<expr> [y=<expr> [z=<expr>]] bins=<nx>,<xmin>,<xmax>[,<ny>,...]
+//          [w=<expr>] [cut=<expr>] [title=<title>]
+// Expressions are RDataFrame (C++) expressions of the branches of the tree
+// (default event_data), e.g. x=rc or cut="itel==1 && photons>10"; values with
+// blanks must be quoted. The number of x/y/z given is the dimension, bins
+// needs three values for each axis.
+class Hist_def
+{
+    public:
+    std::string name;
+    std::string title;
+    std::string tree;
+    int dim;
+    std::string expr[3];
+    int nbins[3];
+    double lo[3];
+    double hi[3];
+    std::string weight;     // empty: unweighted
+    std::string cut;        // empty: all entries
+
+    Hist_def();
+    void clear();
+};
+
+class Hist_defs
+{
+    public:
+    std::vector<Hist_def> defs;
+
+    Hist_defs();
+    ~Hist_defs();
+    void clear();
+    int read(const char* fname);
+    int parse(const std::string& line, const char* where = "definition");
+    void set_default();
+    std::vector<std::string> trees() const;
+    std::string key() const;
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef H_F
+#define H_F
+#include <string>
+#include <vector>
+#include "mc_tel.h"
+#include "Hist_defs.h"
+#include "Spectral_weights.h"
+
+class TH1;
+class TFormula;
+
+// Fills the histograms of Hist_defs during the conversion, without a tree.
+// Definitions may use the event_data variables (photons, itel, rc, run_id,
+// rtel, zenith, energy, gen_index, gen_emin, gen_emax, run, and the spectral
+// weights w_<name> of init()) or the bunch variables (bunch_x, bunch_y, cx, cy,
+// time, p_height, lambda, nbunch, itel, rc, trans, npe, depth), and "area" in both.
+// A plain variable is used directly, other expressions become TFormulas
+// of these variables.
+class Hist_filler
+{
+    public:
+    enum { EVENT_TREE = 0, BUNCH_TREE = 1 };
+
+    std::vector<Hist_def> defs;
+    std::vector<TH1*> hists;
+
+    Hist_filler();
+    ~Hist_filler();
+    void clear();
+    int init(const Hist_defs& hd, const Spectral_weights* sw = NULL);
+    void fill_event(int run_id, int itel, double photons, double rc, double rtel, double zenith, double area,
+                    double energy, double gen_index, double gen_emin, double gen_emax, int run);
+    void fill_bunches(const struct bunch* bunches, int nbunches, int itel, double rc, double area,
+                      const float* trans, const float* npe, const double* depth);
+    void write();
+
+    private:
+    struct value
+    {
+        int var;            // variable index, -1: formula, -2: none
+        TFormula* f;
+    };
+    std::vector<int> tree;
+    bool has_bunch_defs;
+    std::vector<value> val;     // [idef * 5 + k], k: x, y, z, weight, cut
+    Spectral_weights spectra;
+    double last_energy;
+    std::vector<double> event_val;
+    int event_var(const std::string& name) const;
+    int set_value(value& v, const std::string& expr, int t, const std::string& name);
+    void fill(int t, const double* v);
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef L_F
+#define L_F
+#include <vector>
+#include <cstddef>
+
+// Fit of an NKG-like lateral distribution to the photons per telescope of each shower:
+//   expected photons = area * exp(lnA) * (r/r0)^(s-2) * (1 + r/r0)^(s-4.5)
+// with a Poisson likelihood over all telescopes of the shower (also those without
+// photons). r is the core distance [m], clamped to 1 m. The showers are fitted with
+// Minuit2 (analytic gradient) in chunks on a thread pool; within a chunk, showers are
+// ordered by their photon sum and each fit starts from the result of the previous one.
+class Lateral_fit
+{
+    public:
+    struct result
+    {
+        int run;
+        int run_id;
+        int npoints;
+        int status;         // 0: ok, 1: no valid minimum, -1: not fitted (too few telescopes with photons)
+        double photons;
+        double par[3];      // lnA, s, r0 [m]
+        double err[3];
+        double nll;
+        double edm;
+        int nfcn;
+    };
+
+    // points of all showers, sorted by (run, run_id); run_id alone repeats in each run
+    std::vector<int> run, run_id;
+    std::vector<double> r, lr, n, la;   // core distance, log(r), photons, log(area)
+    std::vector<size_t> first;          // points of shower k: first[k] .. first[k+1]-1
+    std::vector<result> results;        // one per shower, by (run, run_id)
+    int min_points;
+    size_t chunk;
+
+    Lateral_fit();
+    ~Lateral_fit();
+    void clear();
+    void set_points(const std::vector<int>& runs, const std::vector<int>& id, const std::vector<double>& rc,
+                    const std::vector<double>& photons, const std::vector<double>& area);
+    void fit_all(int nthreads = 0);
+    void fit(size_t k, const double* start, result& res) const;
+    static double nll(const double* par, const double* r, const double* lr, const double* n, const double* la,
+                      size_t np, double* grad);
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
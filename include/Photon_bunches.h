@@ -16,6 +16,9 @@ class Photon_bunches : public TObject
         double nbunch;
         int itel;
         double  rc; //use telescope instead
+        double trans; // atmospheric transmission, 1 if not applied
+        double npe;   // expected photo-electrons, -1 if not computed
+        double depth; // slant depth of the emission point [g/cm^2], -1 without the file's atmospheric profile
 
     public:
         Photon_bunches();
@@ -53,9 +56,21 @@ class Photon_bunches : public TObject
         {
             nbunch = n;
         }
+        void set_trans(double t)
+        {
+            trans = t;
+        }
+        void set_npe(double n)
+        {
+            npe = n;
+        }
+        void set_depth(double d)
+        {
+            depth = d;
+        }
         void clear();
         void fill_photon_bunch(struct bunch, int i, int j, double r);
-        ClassDef(Photon_bunches, 1);
+        ClassDef(Photon_bunches, 4);
 };
 
 
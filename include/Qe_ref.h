@@ -0,0 +1,48 @@
+#ifndef Q_R
+#define Q_R
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+#include "mc_tel.h"
+
+// Combined photon detection efficiency (quantum efficiency x mirror
+// reflectivity [x secondary mirror reflectivity]) from the two-column
+// sim_telarray tables (wavelength [nm], value), tabulated at 1 nm steps
+// like the arrays of read_qe_ref() in absorb.h.
+// Bunches with lambda = 0 get a wavelength drawn from the lambda^-2
+// Cherenkov spectrum between lambda_min and lambda_max (the CORSIKA
+// bandwidth, EVTH words 96/97). The random numbers are counter based,
+// so one batch is drawn in a single vectorizable loop and the result only
+// depends on seed, key and bunch index.
+class Qe_ref
+{
+    public:
+    int max_lambda;
+    std::vector<float> eff;         // [nm], 0 to max_lambda-1
+    double lambda_min, lambda_max;
+    uint64_t seed;
+
+    Qe_ref();
+    ~Qe_ref();
+    void clear();
+    int read(const char* qe_fname, const char* ref_fname, const char* ref2_fname = NULL);
+    void set_bandwidth(double lmin, double lmax);
+    double efficiency(double lambda) const;
+    void efficiency(const struct bunch* bunches, int nbunches, uint64_t key, float* out) const;
+    double expected_pe(const struct bunch* bunches, int nbunches, uint64_t key, const float* trans, float* npe) const;
+
+    static int read_table(const char* fname, std::vector<double>& wl, std::vector<double>& val);
+    static void uniform(uint64_t seed, uint64_t key, size_t n, double* u);
+};
+
+
+
+
+
+
+
+
+
+
+
+#endif
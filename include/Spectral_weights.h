@@ -0,0 +1,52 @@
+#ifndef S_W
+#define S_W
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Weights from the generated energy spectrum (CORSIKA run header: power law
+// E^gen_index between e_min and e_max [GeV]) to target spectra, each a
+// log-parabola (E/e0)^(index - beta*ln(E/e0)) (a power law for beta = 0).
+// Both spectra are normalized over [e_min, e_max], so the weights keep the
+// number of showers and only change the shape; they are 0 outside the range.
+// ln(weight) is quadratic in ln(E), so weights() computes all targets for an
+// array of energies with one log and one exp per value.
+class Spectral_weights
+{
+    public:
+    double gen_index, e_min, e_max;
+    std::vector<std::string> names;
+    std::vector<double> index, beta, e0;
+    std::vector<double> c0, c1, c2;     // ln(weight) = c0 + c1*ln(E) + c2*ln(E)^2, per target
+
+    Spectral_weights();
+    ~Spectral_weights();
+    void clear();
+    int add_target(const std::string& name, double idx, double b = 0., double e_ref = 1000.);
+    int add_target(const char* spec);
+    void set_generation(double idx, double lo, double hi);
+    void weights(const double* energy, size_t n, double* w) const;
+    double weight(size_t k, double energy) const;
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef T_D
+#define T_D
+#include <vector>
+#include <cstddef>
+
+// Merging t-digest (T. Dunning) for streaming quantiles of weighted values.
+// Values are buffered and merged into about compression/2 centroids
+// (scale function k1), so memory stays bounded however many values
+// are added. Digests of different threads or files are combined with merge().
+// The error is smallest near the tails, typically below 1e-3 in quantile.
+class Tdigest
+{
+    public:
+    double compression;
+    std::vector<double> mean;     // centroids, sorted by mean
+    std::vector<double> weight;
+    double total;                 // weight of the centroids and the buffer
+    double min, max;
+
+    Tdigest(double c = 100.);
+    ~Tdigest();
+    void clear();
+    void add(double x, double w = 1.);
+    void add_centroids(const double* m, const double* w, size_t n, double lo, double hi);
+    void merge(const Tdigest& o);
+    void compress();
+    double quantile(double q);
+    bool empty() const
+    {
+        return total <= 0.;
+    }
+
+    private:
+    std::vector<double> buf_x, buf_w;
+};
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+#endif
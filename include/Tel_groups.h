@@ -18,6 +18,7 @@ class Tel_groups
     double *dist;//!
     Tel_groups();
     ~Tel_groups();
+    void set_tel_pos();
     void set();
     void clear();
     void compute_dist();
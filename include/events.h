@@ -8,16 +8,45 @@ class events: public TObject
         int itel;
         double rc;
         int run_id;
+        int run;        // CORSIKA run number; run_id restarts in each run
+        double rtel;    // telescope sphere radius [m], 0 if unknown
+        double zenith;  // shower zenith angle [deg]
+        double energy;  // shower energy [GeV]
+        double gen_index, gen_emin, gen_emax;   // generated spectrum E^gen_index in [gen_emin, gen_emax] GeV
 
         void clear()
         {
-            run_id = itel = 0;
+            run_id = itel = run = 0;
             photons = rc = 0.;
+            rtel = zenith = 0.;
+            energy = gen_index = gen_emin = gen_emax = 0.;
+        }
+        void set_run(int r)
+        {
+            run = r;
+        }
+        void set_rtel(double r)
+        {
+            rtel = r;
+        }
+        void set_zenith(double z)
+        {
+            zenith = z;
+        }
+        void set_energy(double e)
+        {
+            energy = e;
+        }
+        void set_generation(double index, double emin, double emax)
+        {
+            gen_index = index;
+            gen_emin = emin;
+            gen_emax = emax;
         }
         void fill(int , int ,  double, double);
         events();
         ~events();
-    ClassDef(events, 1);
+    ClassDef(events, 4);
 };
 
 void events::fill(int i, int j,  double size, double dist )
@@ -31,8 +60,11 @@ void events::fill(int i, int j,  double size, double dist )
 events::events()
 {
  run_id = 0;
+ run = 0;
  itel = 0;
  photons = rc =0.;
+ rtel = zenith = 0.;
+ energy = gen_index = gen_emin = gen_emax = 0.;
 }
 events::~events()
 {
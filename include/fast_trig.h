@@ -0,0 +1,199 @@
+/* ================================================================ */
+/** @file fast_trig.h
+ *  @short Polynomial sin/cos/atan2/asin/acos kernels with bounded error.
+ *
+ *  Branch-free replacements for the libm calls in the geometry code,
+ *  written so that loops over arrays can be auto-vectorized
+ *  (needs -O3 -fno-math-errno -fno-trapping-math with gcc).
+ *  The polynomials are minimax (asin: weighted least-squares) fits
+ *  on the reduced ranges.
+ *  Maximum errors, as measured with src/bench_fast_trig.c
+ *  against libm on 10^7 random arguments:
+ *
+ *  - fast_sincos: absolute error < 5e-12 for |x| <= 1e5 rad.
+ *  - fast_atan2, fast_atan:  absolute error < 2e-11 rad.
+ *  - fast_asin, fast_acos:   absolute error < 5e-14 rad on [-1,1]
+ *    (own kernel; the earlier atan2-based versions were no faster
+ *    than libm on some machines).
+ *
+ *  Speed-up over libm per call in Bench_trig (x86-64, gcc -O3,
+ *  10^7 arguments): sincos 2.7, atan2 4.6-6.5, asin 4.1-4.5,
+ *  acos 4.2-4.5; in rec_tools.c angle_between 2.8, compute_true_dsp
+ *  1.4 and offset_to_angles about 1 (no gain). These depend on the
+ *  CPU and libm version, so rerun Bench_trig before relying on them.
+ *
+ *  Results for non-finite arguments are undefined.
+ */
+/* ================================================================ */
+
+#ifndef FAST_TRIG_H__LOADED
+#define FAST_TRIG_H__LOADED 1
+
+#include <math.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FT_2_OVER_PI 6.36619772367581382433e-01
+#define FT_PIO2_HI   1.57079632673412561417e+00 /* first 33 bits of pi/2 */
+#define FT_PIO2_LO   6.07710050650619224932e-11 /* pi/2 - FT_PIO2_HI */
+#define FT_PIO2      1.57079632679489655800e+00
+#define FT_PIO4      7.85398163397448278999e-01
+#define FT_PI        3.14159265358979311600e+00
+#define FT_TAN_PI8   4.14213562373095034000e-01
+#define FT_ROUND_MAGIC 6755399441055744.0      /* 1.5*2^52, rounds to nearest integer */
+
+/* sin(r)/r and cos(r) on |r| <= pi/4, as polynomials in r*r. */
+#define FT_S0  9.999999999954503e-01
+#define FT_S1 -1.6666666630446167e-01
+#define FT_S2  8.333328690151035e-03
+#define FT_S3 -1.9839178355620686e-04
+#define FT_S4  2.717152808450396e-06
+
+#define FT_C0  9.999999999999344e-01
+#define FT_C1 -4.999999999927125e-01
+#define FT_C2  4.166666653369063e-02
+#define FT_C3 -1.3888879934256697e-03
+#define FT_C4  2.479884422767786e-05
+#define FT_C5 -2.7167979170515524e-07
+
+/* atan(u)/u on |u| <= tan(pi/8), as polynomial in u*u. */
+#define FT_A0  9.999999999792973e-01
+#define FT_A1 -3.333333213493845e-01
+#define FT_A2  1.9999886376945353e-01
+#define FT_A3 -1.4281651120539798e-01
+#define FT_A4  1.1041187204107618e-01
+#define FT_A5 -8.45979727754419e-02
+#define FT_A6  4.714332294463416e-02
+
+/* (asin(s)-s)/s^3 on |s| <= 1/2, as polynomial in z = s*s. */
+#define FT_AS0 1.6666666674546987e-01
+#define FT_AS1 7.499999042165473e-02
+#define FT_AS2 4.464329155507885e-02
+#define FT_AS3 3.037186926968705e-02
+#define FT_AS4 2.2507322957906098e-02
+#define FT_AS5 1.6248417344766224e-02
+#define FT_AS6 1.9489835514758514e-02
+#define FT_AS7 -4.608911439833626e-03
+#define FT_AS8 3.345452015555933e-02
+
+/* ------------------------- fast_sincos ------------------------- */
+/**
+ *  @short Sine and cosine of x with one range reduction.
+ */
+
+static inline void fast_sincos (double x, double *s, double *c)
+{
+   double k = (x * FT_2_OVER_PI + FT_ROUND_MAGIC) - FT_ROUND_MAGIC;
+   double r = (x - k*FT_PIO2_HI) - k*FT_PIO2_LO;
+   double r2 = r*r;
+   double sr = r * (FT_S0 + r2*(FT_S1 + r2*(FT_S2 + r2*(FT_S3 + r2*FT_S4))));
+   double cr = FT_C0 + r2*(FT_C1 + r2*(FT_C2 + r2*(FT_C3 + r2*(FT_C4 + r2*FT_C5))));
+   int q = (int) k;
+   double ss = (q & 1) ? cr : sr;
+   double cc = (q & 1) ? sr : cr;
+
+   *s = (q & 2) ? -ss : ss;
+   *c = ((q+1) & 2) ? -cc : cc;
+}
+
+static inline double fast_sin (double x)
+{
+   double s, c;
+   fast_sincos(x, &s, &c);
+   return s;
+}
+
+static inline double fast_cos (double x)
+{
+   double s, c;
+   fast_sincos(x, &s, &c);
+   return c;
+}
+
+/* ------------------------- fast_atan2 -------------------------- */
+/**
+ *  @short Four-quadrant arc tangent, as atan2(y,x) in [-pi,pi].
+ */
+
+static inline double fast_atan2 (double y, double x)
+{
+   double ax = fabs(x), ay = fabs(y);
+   double mx = (ax > ay) ? ax : ay;
+   double mn = (ax > ay) ? ay : ax;
+   double t = mn / ((mx > 0.) ? mx : 1.);
+   /* Beyond tan(pi/8) use atan(t) = pi/4 + atan((t-1)/(t+1)) */
+   double big = (t > FT_TAN_PI8) ? 1. : 0.;
+   double u = (t - big) / (1. + big*t);
+   double u2 = u*u;
+   double a = u * (FT_A0 + u2*(FT_A1 + u2*(FT_A2 + u2*(FT_A3 +
+                   u2*(FT_A4 + u2*(FT_A5 + u2*FT_A6))))));
+
+   a += big * FT_PIO4;
+   a = (ay > ax) ? FT_PIO2 - a : a;
+   a = (x < 0.) ? FT_PI - a : a;
+   return copysign(a, y);
+}
+
+static inline double fast_atan (double x)
+{
+   return fast_atan2(x, 1.);
+}
+
+/* ---------------------- fast_asin, fast_acos ------------------- */
+/**
+ *  @short Arc sine and cosine without a division: a polynomial on
+ *     |x| <= 1/2 and the half-angle identity
+ *     asin(x) = pi/2 - 2*asin(sqrt((1-x)/2)) beyond.
+ */
+
+static inline double ft_asin_half (double x, double *p)
+{
+   double ax = fabs(x);
+   double big = (ax > 0.5) ? 1. : 0.;
+   double z = (ax > 0.5) ? 0.5*(1.-ax) : ax*ax;
+   double s = (ax > 0.5) ? sqrt(z) : ax;
+   *p = s + s*z*(FT_AS0 + z*(FT_AS1 + z*(FT_AS2 + z*(FT_AS3 + z*(FT_AS4 +
+            z*(FT_AS5 + z*(FT_AS6 + z*(FT_AS7 + z*FT_AS8))))))));
+   return big;
+}
+
+static inline double fast_asin (double x)
+{
+   double p;
+   double big = ft_asin_half(x, &p);
+   return copysign(big > 0. ? FT_PIO2 - 2.*p : p, x);
+}
+
+static inline double fast_acos (double x)
+{
+   double p;
+   double big = ft_asin_half(x, &p);
+   double a_small = FT_PIO2 - copysign(p, x);
+   double a_big = (x > 0.) ? 2.*p : FT_PI - 2.*p;
+   return big > 0. ? a_big : a_small;
+}
+
+/* ---------------------- Array versions ------------------------- */
+
+static inline void fast_sincos_v (const double *x, double *s, double *c, size_t n)
+{
+   size_t i;
+   for ( i=0; i<n; i++ )
+      fast_sincos(x[i], &s[i], &c[i]);
+}
+
+static inline void fast_atan2_v (const double *y, const double *x, double *a, size_t n)
+{
+   size_t i;
+   for ( i=0; i<n; i++ )
+      a[i] = fast_atan2(y[i], x[i]);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
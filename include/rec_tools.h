@@ -24,6 +24,23 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 extern "C" {
 #endif
 
+/** Trigonometric constants and shower-frame rotation for one pointing direction. */
+
+struct pointing_trans
+{
+   double azimuth, altitude;  /**< Pointing direction [rad], used as cache key. */
+   double cos_az, sin_az;     /**< Cosine and sine of azimuth. */
+   double cos_alt, sin_alt;   /**< Cosine and sine of altitude. */
+   double trans[3][3];        /**< As from get_shower_trans_matrix(); trans[2] is the pointing direction. */
+};
+typedef struct pointing_trans PointingTrans;
+
+const PointingTrans *get_pointing_trans(double azimuth, double altitude);
+void clear_pointing_trans_cache(void);
+
+int rec_set_fast_trig(int on);
+int rec_get_fast_trig(void);
+
 void angles_to_offset(double obj_azimuth, double obj_altitude, 
    double azimuth, double altitude, double focal_length, 
    double *xoff, double *yoff);
@@ -52,6 +69,10 @@ double line_point_distance (double xp1, double yp1, double zp1,
    double x, double y, double z);
 
 double compute_true_dsp(double azimuth, double altitude, double corex, double corey, double tel_x, double tel_y,double tel_az, double tel_al);
+int compute_true_dsp_batch(int nevt, const double *azimuth, const double *altitude,
+   const double *corex, const double *corey,
+   int ntel, const double *tel_x, const double *tel_y,
+   const double *tel_az, const double *tel_al, double *theta);
 double compute_axis_diff(double ph1, double ph2);
 
 #ifdef __cplusplus
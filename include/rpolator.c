@@ -45,6 +45,7 @@
 
 #include <math.h>
 #include <ctype.h>
+#include <limits.h>
 
 #include "rpolator.h"
 #include "straux.h"
@@ -86,305 +87,807 @@ static void strip_comments(char *line)
    }
 }
 
-/* ----------------------------- read_table -------------------------- */
+/* ====================== Fast reading of text tables ======================= */
+
+/*
+   The read_table*() functions work on the whole file at once: plain
+   files are mapped into memory (other input, like compressed files,
+   is read into memory through fileopen()), large files are split at
+   line boundaries into pieces parsed in parallel, and plain decimal
+   numbers are converted without going through sscanf(). Lines are cut
+   into the same pieces as by fgets() with the line buffers used before,
+   comments are stripped by strip_comments(), and anything not plainly
+   decimal is passed to sscanf() as before, so results and messages do
+   not change. Compile with -DRPOL_NO_THREADS for serial parsing only.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <float.h>
+#include <stdint.h>
+#ifndef RPOL_NO_THREADS
+# include <pthread.h>
+#endif
+
+#if defined(__GNUC__)
+# define RPOL_ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+# define RPOL_ATOMIC_STORE(p,v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+# define RPOL_ATOMIC_ADD(p,v) __atomic_add_fetch((p), (v), __ATOMIC_ACQ_REL)
+#else
+# define RPOL_ATOMIC_LOAD(p) (*(p))
+# define RPOL_ATOMIC_STORE(p,v) (*(p) = (v))
+# define RPOL_ATOMIC_ADD(p,v) (*(p) += (v))
+#endif
+
+/* Files smaller than this are not worth starting threads for */
+#ifndef RPOL_READ_MIN_PER_THREAD
+# define RPOL_READ_MIN_PER_THREAD (256*1024)
+#endif
+#ifndef RPOL_READ_MAX_THREADS
+# define RPOL_READ_MAX_THREADS 16
+#endif
+
+/** Whole file contents in memory, either mapped or allocated. */
+
+struct rpol_text
+{
+   char *buf;
+   size_t len;
+   int mapped;
+};
+
+/* --------------------------- rpol_text_load ---------------------------- */
 /**
- *  @short Low-level reading of 2-column data tables up to given number of data rows.
- *
- *  @param fname Name of file to be opened.
- *  @param maxrow Maximum number of (non-empty, non-comment) rows of data to read.
- *  @param col1 Array where values of column 1 are to be copied to.
- *  @param col2 Array where values of column 2 are to be copied to.
+ *  @short Get the contents of a table file (or the rest of an open file).
  *
- *  @return Number of data rows read (usable values in col1 and col2)
- *     or -1 (error).
+ *  @return 0 (OK), -1 (file not found, reported with perror() as before),
+ *          -2 (memory allocation error).
  */
 
-int read_table (const char *fname, int maxrow, double *col1, double *col2)
+static int rpol_text_load (const char *fname, FILE *fptr, struct rpol_text *txt)
 {
-   FILE *f;
-   double x, y;
-   char line[1024];
-   int iline = 0, n=0, rc = 0;
-   
-   if ( (f = fileopen(fname,"r")) == NULL )
+   FILE *f = fptr;
+   size_t l = strlen(fname), alen = 0, n;
+
+   txt->buf = NULL;
+   txt->len = 0;
+   txt->mapped = 0;
+
+   /* Plain files we can map; anything fileopen() may treat in a special way is read through it. */
+   if ( fptr == NULL && strcmp(fname,"-") != 0 && strchr(fname,':') == NULL &&
+        !(l > 3 && strcmp(fname+l-3,".gz") == 0) && !(l > 4 && strcmp(fname+l-4,".bz2") == 0) &&
+        !(l > 3 && strcmp(fname+l-3,".xz") == 0) && !(l > 5 && strcmp(fname+l-5,".lzma") == 0) &&
+        !(l > 4 && strcmp(fname+l-4,".lz4") == 0) && !(l > 4 && strcmp(fname+l-4,".zst") == 0) &&
+        !(l > 5 && strcmp(fname+l-5,".zstd") == 0) )
+   {
+      int fd = open(fname, O_RDONLY);
+      if ( fd >= 0 )
+      {
+         struct stat st;
+         if ( fstat(fd, &st) == 0 && S_ISREG(st.st_mode) )
+         {
+            if ( st.st_size == 0 )
+            {
+               close(fd);
+               return 0;
+            }
+            txt->buf = (char *) mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if ( txt->buf != (char *) MAP_FAILED )
+            {
+               close(fd);
+               txt->len = (size_t) st.st_size;
+               txt->mapped = 1;
+#ifdef MADV_SEQUENTIAL
+               madvise(txt->buf, txt->len, MADV_SEQUENTIAL);
+#endif
+               return 0;
+            }
+            txt->buf = NULL;
+         }
+         close(fd);
+      }
+   }
+
+   if ( f == NULL && (f = fileopen(fname,"r")) == NULL )
    {
       perror(fname);
       return -1;
    }
-   
-   while ( fgets(line,sizeof(line)-1,f) != NULL )
+   for (;;)
    {
-      iline++;
-      strip_comments(line);
-
-      if ( line[0] == '\0' )
-      	 continue;
-      
-      if ( (rc=sscanf(line,"%lf %lf",&x,&y)) != 2 )
-      {
-      	 fprintf(stderr,"Error in line %d of file %s (expcting 2 values, found %d).\n",
-            iline,fname,rc);
-	 fileclose(f);
-	 return -1;
-      }
-      if ( n >= maxrow )
+      if ( txt->len + 65536 > alen )
       {
-      	 fprintf(stderr,"Too many entries in file %s (max=%d)\n",fname,maxrow);
-	 fileclose(f);
-	 return -1;
+         char *p = (char *) realloc(txt->buf, alen = 2*alen + 65536);
+         if ( p == NULL )
+         {
+            free(txt->buf);
+            txt->buf = NULL;
+            txt->len = 0;
+            if ( fptr == NULL && f != stdin )
+               fileclose(f);
+            return -2;
+         }
+         txt->buf = p;
       }
-      col1[n] = x;
-      col2[n] = y;
-      n++;
+      if ( (n = fread(txt->buf+txt->len, 1, alen-txt->len, f)) == 0 )
+         break;
+      txt->len += n;
    }
-   
-   fflush(stdout);
-   fprintf(stderr,"Table with %d rows has been read from file %s\n",n,fname);
-   fileclose(f);
+   if ( fptr == NULL && f != stdin )
+      fileclose(f);
+   return 0;
+}
 
-   return n;
+static void rpol_text_free (struct rpol_text *txt)
+{
+   if ( txt->buf != NULL )
+   {
+      if ( txt->mapped )
+         munmap(txt->buf, txt->len);
+      else
+         free(txt->buf);
+   }
+   txt->buf = NULL;
+   txt->len = 0;
+   txt->mapped = 0;
 }
 
-/* read_table2 is just the same as read_table */
+/* --------------------------- rpol_next_line ---------------------------- */
+/**
+ *  @short Copy the next piece of text from p into line, as fgets(line,lsize-1,f) 
+ *     would do it: up to and including a newline, but at most lsize-2 characters.
+ *
+ *  @return Pointer to the start of the following piece.
+ */
 
-int read_table2 (const char *fname, int maxrow, double *col1, double *col2)
+static const char *rpol_next_line (const char *p, const char *end, char *line, size_t lsize)
 {
-   return read_table(fname,maxrow,col1,col2);
+   size_t m = (size_t) (end - p);
+   const char *nl;
+
+   if ( m > lsize-2 )
+      m = lsize-2;
+   if ( (nl = (const char *) memchr(p, '\n', m)) != NULL )
+      m = (size_t) (nl - p) + 1;
+   memcpy(line, p, m);
+   line[m] = '\0';
+   return p + m;
 }
 
-/* ----------------------------- read_table3 -------------------------- */
-/** read_table3() and so on have more columns than read_table but
-    are still only suitable for 1-D interpolation. */
+/* --------------------------- rpol_fast_double -------------------------- */
+/**
+ *  @short Conversion of plain decimal numbers ([+-]digits[.digits][e[+-]digits]).
+ *
+ *  With up to 19 significant digits and a decimal exponent small enough that
+ *  the result is exact after a single multiplication or division (Clinger's
+ *  fast path) the number is converted here, other plain decimal numbers
+ *  are passed to strtod(). Either way the result is the correctly rounded
+ *  value, as from sscanf().
+ *
+ *  @return 1 if converted and followed by white space or end of string, 
+ *          0 if the text has to go through sscanf() instead.
+ */
 
-int read_table3 (const char *fname, int maxrow, 
-   double *col1, double *col2, double *col3);
+static const double rpol_pow10[23] = 
+{
+   1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
 
-int read_table3 (const char *fname, int maxrow, 
-   double *col1, double *col2, double *col3)
+static int rpol_fast_double (const char *s, const char **end, double *v)
 {
-   FILE *f;
-   double x, y, z;
-   char line[1024];
-   int iline = 0, n=0, rc = 0;
+   const char *start = s;
+   uint64_t mant = 0;
+   int neg = 0, nd = 0, nsig = 0, e10 = 0, slow = 0;
+   double d;
 
-   if ( (f = fileopen(fname,"r")) == NULL )
+   if ( *s == '-' || *s == '+' )
+      neg = (*s++ == '-');
+   for ( ; *s >= '0' && *s <= '9'; s++, nd++ )
    {
-      perror(fname);
-      return -1;
+      if ( mant == 0 && *s == '0' )
+         continue;
+      if ( ++nsig > 19 )
+         slow = 1;
+      else
+         mant = 10*mant + (uint64_t) (*s - '0');
    }
-
-   while ( fgets(line,sizeof(line)-1,f) != NULL )
+   if ( *s == '.' )
    {
-      iline++;
-      strip_comments(line);
-
-      if ( line[0] == '\0' )
-      	 continue;
-      
-      if ( (rc = sscanf(line,"%lf %lf %lf",&x,&y,&z)) != 3 )
+      for ( s++; *s >= '0' && *s <= '9'; s++, nd++ )
       {
-      	 fprintf(stderr,"Error in line %d of file %s (expecting 3 values, found %d)\n",
-            iline,fname,rc);
-	 fileclose(f);
-	 return -1;
+         if ( mant == 0 && *s == '0' )
+         {
+            e10--;
+            continue;
+         }
+         if ( ++nsig > 19 )
+            slow = 1;
+         else
+         {
+            mant = 10*mant + (uint64_t) (*s - '0');
+            e10--;
+         }
       }
-      if ( n >= maxrow )
+   }
+   if ( nd == 0 )
+      return 0;
+   if ( *s == 'e' || *s == 'E' )
+   {
+      int eneg = 0, ex = 0, ne = 0;
+      s++;
+      if ( *s == '-' || *s == '+' )
+         eneg = (*s++ == '-');
+      for ( ; *s >= '0' && *s <= '9'; s++ )
       {
-      	 fprintf(stderr,"Too many entries in file %s (max=%d)\n",fname,maxrow);
-	 fileclose(f);
-	 return -1;
+         if ( ++ne > 4 )
+            slow = 1;
+         else
+            ex = 10*ex + (*s - '0');
       }
-      col1[n] = x;
-      col2[n] = y;
-      col3[n] = z;
-      n++;
+      if ( ne == 0 )
+         return 0;
+      e10 += eneg ? -ex : ex;
+   }
+   if ( *s != '\0' && !isspace((unsigned char) *s) )
+      return 0;
+   if ( mant == 0 && !slow )
+      e10 = 0;
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+   if ( !slow && mant <= ((uint64_t) 1 << 53) && e10 >= -22 && e10 <= 22 )
+   {
+      d = (double) mant;
+      if ( e10 < 0 )
+         d /= rpol_pow10[-e10];
+      else
+         d *= rpol_pow10[e10];
+      *v = neg ? -d : d;
+      *end = s;
+      return 1;
+   }
+#endif
+   {
+      char *e;
+      d = strtod(start, &e);
+      if ( e != s )
+         return 0;
+      *v = d;
+      *end = s;
+      return 1;
    }
-
-   fflush(stdout);
-   fprintf(stderr,"Table with %d rows has been read from file %s\n",n,fname);
-   fileclose(f);
-
-   return n;
 }
 
-/* ----------------------------- read_table4 -------------------------- */
-
-int read_table4 (const char *fname, int maxrow, 
-   double *col1, double *col2, double *col3, double *col4);
+/* --------------------------- rpol_scan_line ---------------------------- */
+/**
+ *  @short Same result as sscanf(line,"%lf %lf ...",...) for ncol (2 to 5) values.
+ */
 
-int read_table4 (const char *fname, int maxrow, 
-   double *col1, double *col2, double *col3, double *col4)
+static int rpol_scan_line (const char *line, int ncol, double *v)
 {
-   FILE *f;
-   double x, y, z, u;
-   char line[1024];
-   int iline = 0, n=0;
+   const char *s = line;
+   int k;
 
-   if ( (f = fileopen(fname,"r")) == NULL )
+   for ( k=0; k<ncol; k++ )
    {
-      perror(fname);
-      return -1;
+      while ( isspace((unsigned char) *s) )
+         s++;
+      if ( *s == '\0' )
+         return (k == 0) ? EOF : k;
+      if ( !rpol_fast_double(s, &s, &v[k]) )
+         break;
    }
+   if ( k == ncol )
+      return ncol;
 
-   while ( fgets(line,sizeof(line)-1,f) != NULL )
+   switch ( ncol )
    {
-      iline++;
-      strip_comments(line);
+      case 2:
+         return sscanf(line,"%lf %lf",&v[0],&v[1]);
+      case 3:
+         return sscanf(line,"%lf %lf %lf",&v[0],&v[1],&v[2]);
+      case 4:
+         return sscanf(line,"%lf %lf %lf %lf",&v[0],&v[1],&v[2],&v[3]);
+      case 5:
+         return sscanf(line,"%lf %lf %lf %lf %lf",&v[0],&v[1],&v[2],&v[3],&v[4]);
+   }
+   return 0;
+}
 
-      if ( line[0] == '\0' )
-      	 continue;
-      
-      if ( sscanf(line,"%lf %lf %lf %lf",&x,&y,&z,&u) != 4 )
-      {
-      	 fprintf(stderr,"Error in line %d of file %s\n",iline,fname);
-	 fileclose(f);
-	 return -1;
-      }
-      if ( n >= maxrow )
+/* Same result as sscanf(word,"%lf",v) */
+
+static int rpol_scan_word (const char *word, double *v)
+{
+   const char *s = word;
+   while ( isspace((unsigned char) *s) )
+      s++;
+   if ( *s != '\0' && rpol_fast_double(s, &s, v) )
+      return 1;
+   return sscanf(word, "%lf", v);
+}
+
+/** Messages from read_table_v(), printed in file order after parsing. */
+
+struct rpol_read_msg
+{
+   size_t iline;      /**< Line number within the chunk */
+   size_t rows;       /**< Data rows in the chunk before this message */
+   size_t nc;         /**< Column number (type 1) or number of columns (type 2) */
+   int type;          /**< 1: invalid data, 2: not enough columns */
+};
+
+/** One piece of the text parsed by one thread. */
+
+struct rpol_read_chunk
+{
+   const char *start, *end; /**< Text of this chunk, starting at the beginning of a line */
+   size_t lsize;      /**< Size of the line buffer emulated */
+   int ncol;          /**< Values per row stored */
+   int vmode;         /**< 0: read_table2...5 rules, 1: read_table_v rules */
+   size_t maxcol;     /**< read_table_v: columns to be parsed */
+   const size_t *rcol; /**< read_table_v: used columns (non-zero) */
+   const size_t *selcol; /**< read_table_v: selected column order or NULL */
+   size_t maxrows;    /**< Stop after more than this number of rows */
+   size_t nlines;     /**< Lines (fgets pieces) in the chunk, up to the error if any */
+   size_t nrows;      /**< Data rows stored */
+   double *val;       /**< Values, ncol per row */
+   size_t aval;       /**< Allocated rows */
+   size_t err_line;   /**< Local line number of first error (0: none) */
+   int err_rc;        /**< Number of values found in that line */
+   struct rpol_read_msg *msg; /**< read_table_v messages */
+   size_t nmsg, amsg;
+   int nomem;         /**< Memory allocation failed */
+   int stopped;       /**< Stopped early, at an error or after maxrows rows */
+   int idx;           /**< Index of this chunk */
+   struct rpol_read_chunk *all; /**< All chunks, to see if an earlier one stopped */
+};
+
+static int rpol_chunk_add_row (struct rpol_read_chunk *c, const double *v)
+{
+   if ( c->nrows >= c->aval )
+   {
+      size_t na = c->aval ? 2*c->aval : 1024;
+      double *p = (double *) realloc(c->val, na*c->ncol*sizeof(double));
+      if ( p == NULL )
       {
-      	 fprintf(stderr,"Too many entries in file %s (max=%d)\n",fname,maxrow);
-	 fileclose(f);
-	 return -1;
+         c->nomem = 1;
+         return -1;
       }
-      col1[n] = x;
-      col2[n] = y;
-      col3[n] = z;
-      col4[n] = u;
-      n++;
+      c->val = p;
+      c->aval = na;
    }
-
-   fflush(stdout);
-   fprintf(stderr,"Table with %d rows has been read from file %s\n",n,fname);
-   fileclose(f);
-
-   return n;
+   memcpy(c->val + c->nrows*c->ncol, v, c->ncol*sizeof(double));
+   c->nrows++;
+   return 0;
 }
 
-/* ----------------------------- read_table5 -------------------------- */
+static int rpol_chunk_add_msg (struct rpol_read_chunk *c, int type, size_t nc)
+{
+   if ( c->nmsg >= c->amsg )
+   {
+      size_t na = c->amsg ? 2*c->amsg : 16;
+      struct rpol_read_msg *p = (struct rpol_read_msg *) realloc(c->msg, na*sizeof(struct rpol_read_msg));
+      if ( p == NULL )
+      {
+         c->nomem = 1;
+         return -1;
+      }
+      c->msg = p;
+      c->amsg = na;
+   }
+   c->msg[c->nmsg].iline = c->nlines;
+   c->msg[c->nmsg].rows = c->nrows;
+   c->msg[c->nmsg].nc = nc;
+   c->msg[c->nmsg].type = type;
+   c->nmsg++;
+   return 0;
+}
 
-int read_table5 (const char *fname, int maxrow, 
-   double *col1, double *col2, double *col3, double *col4, double *col5);
+/* --------------------------- rpol_parse_chunk -------------------------- */
+/**
+ *  @short Parse one chunk of a table, line by line, with the rules of
+ *     read_table2() ... read_table5() or of read_table_v().
+ */
 
-int read_table5 (const char *fname, int maxrow, 
-   double *col1, double *col2, double *col3, double *col4, double *col5)
+static void *rpol_parse_chunk (void *arg)
 {
-   FILE *f;
-   double x, y, z, u, v;
-   char line[1024];
-   int iline = 0, n=0;
+   struct rpol_read_chunk *c = (struct rpol_read_chunk *) arg;
+   const char *p = c->start;
+   char *line = (char *) malloc(c->lsize);
+   char word[100];
+   double v[5], *rval = NULL;
+   int rc;
 
-   if ( (f = fileopen(fname,"r")) == NULL )
+   if ( line == NULL || (c->vmode && (rval = (double *) calloc(c->maxcol+c->ncol,sizeof(double))) == NULL) )
    {
-      perror(fname);
-      return -1;
+      c->nomem = 1;
+      free(line);
+      return NULL;
    }
 
-   while ( fgets(line,sizeof(line)-1,f) != NULL )
+   while ( p < c->end && !c->nomem )
    {
-      iline++;
+      if ( c->nrows > c->maxrows )
+         break;
+      /* Nothing after a chunk that stopped early is going to be used */
+      if ( (c->nlines & 0xff) == 0 && c->idx > 0 )
+      {
+         int i;
+         for ( i=0; i<c->idx; i++ )
+            if ( RPOL_ATOMIC_LOAD(&c->all[i].stopped) )
+               break;
+         if ( i < c->idx )
+            break;
+      }
+      p = rpol_next_line(p, c->end, line, c->lsize);
+      c->nlines++;
       strip_comments(line);
 
       if ( line[0] == '\0' )
-      	 continue;
-      
-      if ( sscanf(line,"%lf %lf %lf %lf %lf",&x,&y,&z,&u,&v) != 5 )
+         continue;
+
+      if ( !c->vmode )
       {
-      	 fprintf(stderr,"Error in line %d of file %s\n",iline,fname);
-	 fileclose(f);
-	 return -1;
+         if ( (rc = rpol_scan_line(line, c->ncol, v)) != c->ncol )
+         {
+            c->err_line = c->nlines;
+            c->err_rc = rc;
+            break;
+         }
+         rpol_chunk_add_row(c, v);
       }
-      if ( n >= maxrow )
+      else
       {
-      	 fprintf(stderr,"Too many entries in file %s (max=%d)\n",fname,maxrow);
-	 fileclose(f);
-	 return -1;
+         size_t nc = 0, icol;
+         int ipos = 0;
+         char *s = line;
+         while ( *s == ' ' || *s == '\t' )
+            s++;
+
+         for ( ipos=0, nc=0; nc<c->maxcol && s[ipos] != '\0' && 
+               getword(s,&ipos,word,sizeof(word)-1,' ','#') > 0; nc++ )
+         {
+            if ( c->rcol[nc] == 0 )
+               continue; /* Unused column, rval value never filled. */
+            if ( rpol_scan_word(word, &rval[nc]) == 0 )
+            {
+               rval[nc] = 0.;
+               rpol_chunk_add_msg(c, 1, nc+1);
+               break;
+            }
+         }
+         if ( nc == 0 ) /* No data in line: continue quietly */
+            continue;
+         else if ( nc < c->maxcol ) /* Some data but not enough: complain and continue without the data */
+         {
+            rpol_chunk_add_msg(c, 2, nc);
+            continue;
+         }
+         /* Selected columns, in the requested order */
+         for ( icol=0; icol<(size_t)c->ncol; icol++ )
+            rval[c->maxcol+icol] = (c->selcol == NULL) ? rval[icol] : rval[c->selcol[icol]-1];
+         rpol_chunk_add_row(c, rval+c->maxcol);
       }
-      col1[n] = x;
-      col2[n] = y;
-      col3[n] = z;
-      col4[n] = u;
-      col5[n] = v;
-      n++;
    }
 
-   fflush(stdout);
-   fprintf(stderr,"Table with %d rows has been read from file %s\n",n,fname);
-   fileclose(f);
-
-   return n;
+   if ( c->err_line > 0 || c->nrows > c->maxrows || c->nomem ||
+        (c->vmode && c->nrows >= c->maxrows) )
+      RPOL_ATOMIC_STORE(&c->stopped, 1);
+   free(line);
+   free(rval);
+   return NULL;
 }
 
-/* ----------------------------- read_table_v -------------------------- */
+/* --------------------------- rpol_parse_text --------------------------- */
 /**
- *  Read tables any length (up to some ridiculous maximum) with the requested columns
- *  either in natural order or picking columns as requested.
- *  All data areas are dynamically allocated (and must be fresh beforehand).
- *
- *  On memory allocation errors a -1 error code is returned but already allocated parts
- *  are not released and the file may still be opened.
- *
- *  @param fname Name or URL of file to read.
- *  @paran fptr  File pointer if file already open or NULL if fname has to be opened.
- *  @param nrow  Pointer to number of rows with valid data (pass address of a size_t variable).
- *               Input value used to guide initial allocation, not fixing actual rows to read.
- *  @param ncol  Number of columns of data requested to be read.
- *  @param col   Pointer to where pointers to column-wise data get allocated.
- *               (Need to pass address of a double ** variable.)
- *  @param selcol NULL for natural column order or pointer to ncol (natural, >=1) column numbers in selected order.
- *               Example: { 1, 7, 5 } will place data from the first column under (*col)[0],
- *               data from the seventh column under (*col)[1], and data from the fifth column under (*col)[2].
+ *  @short Split the text into chunks at line boundaries and parse them,
+ *     in parallel for large texts. The chunks array must hold
+ *     RPOL_READ_MAX_THREADS elements, initialized except for start/end.
  *
- *  @return 0 (OK), -1 (memory error), -2 (invalid parameter),
- *              -3 (asking for too many columns), -4 (too many rows of data, stopped reading).
+ *  @return Number of chunks used.
  */
 
-int read_table_v (const char *fname, FILE *fptr, size_t *nrow, size_t ncol, double ***col, const size_t *selcol);
-
-int read_table_v (const char *fname, FILE *fptr, size_t *nrow, size_t ncol, double ***col, const size_t *selcol)
+static int rpol_parse_text (const struct rpol_text *txt, struct rpol_read_chunk *chunk)
 {
-   FILE *f = NULL;
-   char line[10240], word[100];
-   size_t astep = 50, arow = 0;
-   size_t iline = 0, icol, maxcol = ncol, maxrow = 100000;
-   size_t arow_ini = 0; /* First need to check pointers before setting this */
-   double *rval = NULL;
-   size_t *rcol = NULL;
-   int rc = 0;
-   int ipos = 0;
-   char *s = NULL;
+   int nth = 1, i, j;
+   const char *end = txt->buf + txt->len;
 
-   if ( fname == NULL || nrow == NULL || ncol < 1 || col == NULL || *col != NULL )
+#ifndef RPOL_NO_THREADS
    {
-      fprintf(stderr,"read_table_v(%s,...): invalid parameter(s)\n", fname);
-      if ( nrow != NULL )
-         *nrow = 0;
-      return -2;
+      long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+      size_t nmax = txt->len / RPOL_READ_MIN_PER_THREAD;
+      if ( ncpu > RPOL_READ_MAX_THREADS )
+         ncpu = RPOL_READ_MAX_THREADS;
+      nth = (ncpu < 1) ? 1 : (int) ncpu;
+      if ( (size_t) nth > nmax )
+         nth = (nmax < 1) ? 1 : (int) nmax;
    }
+#endif
 
-   /* Don't trust in large numbers and ignore zero or negative numbers */
-   arow_ini = (*nrow > 2000) ? 2000 : ( (*nrow <= 0) ? astep : *nrow );
-   if ( arow_ini <= 10 )
-      astep = 10;
-   /* Reset any number to be returned. */
-   *nrow = 0;
+   for ( i=0; i<RPOL_READ_MAX_THREADS; i++ )
+   {
+      chunk[i].idx = i;
+      chunk[i].all = chunk;
+   }
 
-   /* Other than natural order of columns requested ? */
-   if ( selcol != NULL )
+   /* Chunks start after a newline, where fgets() would start a new piece as well. */
+   chunk[0].start = txt->buf;
+   for ( i=1, j=1; i<nth; i++ )
    {
-      for ( icol=0; icol<ncol; icol++ )
+      const char *p = txt->buf + (txt->len / nth) * i;
+      const char *nl;
+      if ( p <= chunk[j-1].start )
+         continue;
+      if ( (nl = (const char *) memchr(p-1, '\n', (size_t) (end-p+1))) == NULL )
+         break;
+      if ( nl+1 >= end )
+         break;
+      chunk[j-1].end = nl+1;
+      chunk[j].start = nl+1;
+      j++;
+   }
+   chunk[j-1].end = end;
+   nth = j;
+
+#ifndef RPOL_NO_THREADS
+   if ( nth > 1 )
+   {
+      pthread_t thr[RPOL_READ_MAX_THREADS];
+      int started[RPOL_READ_MAX_THREADS];
+      for ( i=1; i<nth; i++ )
+         started[i] = (pthread_create(&thr[i], NULL, rpol_parse_chunk, &chunk[i]) == 0);
+      rpol_parse_chunk(&chunk[0]);
+      for ( i=1; i<nth; i++ )
       {
-         if ( selcol[icol] == 0 )
-         {
-            fprintf(stderr,"Column numbers must start at 1.\n");
-            return -3;
-         }
-         if ( selcol[icol] > maxcol )
-            maxcol = selcol[icol];
+         if ( started[i] )
+            pthread_join(thr[i], NULL);
+         else
+            rpol_parse_chunk(&chunk[i]);
       }
+      return nth;
    }
-   if ( maxcol > 500 )
-   {
-      fprintf(stderr,"read_table_v(%s,...): Non-plausible columns requested\n", fname);
+#endif
+   rpol_parse_chunk(&chunk[0]);
+   return nth;
+}
+
+static void rpol_free_chunks (struct rpol_read_chunk *chunk, int n)
+{
+   int i;
+   for ( i=0; i<n; i++ )
+   {
+      free(chunk[i].val);
+      free(chunk[i].msg);
+      chunk[i].val = NULL;
+      chunk[i].msg = NULL;
+   }
+}
+
+/* --------------------------- rpol_read_columns ------------------------- */
+/**
+ *  @short Common part of read_table2() ... read_table5().
+ */
+
+static int rpol_read_columns (const char *fname, int maxrow, int ncol, double **col)
+{
+   struct rpol_text txt;
+   struct rpol_read_chunk chunk[RPOL_READ_MAX_THREADS];
+   size_t iline = 0, i;
+   int n = 0, ic, k, nch;
+
+   if ( rpol_text_load(fname, NULL, &txt) != 0 )
+      return -1;
+
+   memset(chunk, 0, sizeof(chunk));
+   for ( ic=0; ic<RPOL_READ_MAX_THREADS; ic++ )
+   {
+      chunk[ic].lsize = 1024;
+      chunk[ic].ncol = ncol;
+      chunk[ic].maxrows = (maxrow > 0) ? (size_t) maxrow : 0;
+   }
+   nch = (txt.len > 0) ? rpol_parse_text(&txt, chunk) : 0;
+
+   for ( ic=0; ic<nch; ic++ )
+   {
+      struct rpol_read_chunk *c = &chunk[ic];
+      if ( c->nomem )
+      {
+         fprintf(stderr,"Not enough memory for reading file %s\n",fname);
+         n = -1;
+         break;
+      }
+      /* Too many rows before any error in the chunk? */
+      if ( (size_t) n + c->nrows > (size_t) (maxrow > 0 ? maxrow : 0) )
+      {
+      	 fprintf(stderr,"Too many entries in file %s (max=%d)\n",fname,maxrow);
+         n = -1;
+         break;
+      }
+      if ( c->err_line > 0 )
+      {
+         if ( ncol == 2 )
+      	    fprintf(stderr,"Error in line %d of file %s (expcting 2 values, found %d).\n",
+               (int) (iline+c->err_line),fname,c->err_rc);
+         else if ( ncol == 3 )
+      	    fprintf(stderr,"Error in line %d of file %s (expecting 3 values, found %d)\n",
+               (int) (iline+c->err_line),fname,c->err_rc);
+         else
+      	    fprintf(stderr,"Error in line %d of file %s\n",(int) (iline+c->err_line),fname);
+         n = -1;
+         break;
+      }
+      for ( i=0; i<c->nrows; i++ )
+      {
+         for ( k=0; k<ncol; k++ )
+            col[k][n] = c->val[i*ncol+k];
+         n++;
+      }
+      iline += c->nlines;
+   }
+
+   rpol_free_chunks(chunk, nch);
+   rpol_text_free(&txt);
+   if ( n < 0 )
+      return -1;
+
+   fflush(stdout);
+   fprintf(stderr,"Table with %d rows has been read from file %s\n",n,fname);
+
+   return n;
+}
+
+/* ----------------------------- read_table -------------------------- */
+/**
+ *  @short Low-level reading of 2-column data tables up to given number of data rows.
+ *
+ *  @param fname Name of file to be opened.
+ *  @param maxrow Maximum number of (non-empty, non-comment) rows of data to read.
+ *  @param col1 Array where values of column 1 are to be copied to.
+ *  @param col2 Array where values of column 2 are to be copied to.
+ *
+ *  @return Number of data rows read (usable values in col1 and col2)
+ *     or -1 (error).
+ */
+
+int read_table (const char *fname, int maxrow, double *col1, double *col2)
+{
+   double *col[2];
+   col[0] = col1;
+   col[1] = col2;
+   return rpol_read_columns(fname, maxrow, 2, col);
+}
+
+/* read_table2 is just the same as read_table */
+
+int read_table2 (const char *fname, int maxrow, double *col1, double *col2)
+{
+   return read_table(fname,maxrow,col1,col2);
+}
+
+/* ----------------------------- read_table3 -------------------------- */
+/** read_table3() and so on have more columns than read_table but
+    are still only suitable for 1-D interpolation. */
+
+int read_table3 (const char *fname, int maxrow, 
+   double *col1, double *col2, double *col3);
+
+int read_table3 (const char *fname, int maxrow, 
+   double *col1, double *col2, double *col3)
+{
+   double *col[3];
+   col[0] = col1;
+   col[1] = col2;
+   col[2] = col3;
+   return rpol_read_columns(fname, maxrow, 3, col);
+}
+
+/* ----------------------------- read_table4 -------------------------- */
+
+int read_table4 (const char *fname, int maxrow, 
+   double *col1, double *col2, double *col3, double *col4);
+
+int read_table4 (const char *fname, int maxrow, 
+   double *col1, double *col2, double *col3, double *col4)
+{
+   double *col[4];
+   col[0] = col1;
+   col[1] = col2;
+   col[2] = col3;
+   col[3] = col4;
+   return rpol_read_columns(fname, maxrow, 4, col);
+}
+
+/* ----------------------------- read_table5 -------------------------- */
+
+int read_table5 (const char *fname, int maxrow, 
+   double *col1, double *col2, double *col3, double *col4, double *col5);
+
+int read_table5 (const char *fname, int maxrow, 
+   double *col1, double *col2, double *col3, double *col4, double *col5)
+{
+   double *col[5];
+   col[0] = col1;
+   col[1] = col2;
+   col[2] = col3;
+   col[3] = col4;
+   col[4] = col5;
+   return rpol_read_columns(fname, maxrow, 5, col);
+}
+
+/* ----------------------------- read_table_v -------------------------- */
+/**
+ *  Read tables any length (up to some ridiculous maximum) with the requested columns
+ *  either in natural order or picking columns as requested.
+ *  All data areas are dynamically allocated (and must be fresh beforehand).
+ *
+ *  On memory allocation errors a -1 error code is returned but already allocated parts
+ *  are not released and the file may still be opened.
+ *
+ *  @param fname Name or URL of file to read.
+ *  @paran fptr  File pointer if file already open or NULL if fname has to be opened.
+ *               An open file is read up to its end, even if not all rows are used.
+ *  @param nrow  Pointer to number of rows with valid data (pass address of a size_t variable).
+ *               Input value used to guide initial allocation, not fixing actual rows to read.
+ *  @param ncol  Number of columns of data requested to be read.
+ *  @param col   Pointer to where pointers to column-wise data get allocated.
+ *               (Need to pass address of a double ** variable.)
+ *  @param selcol NULL for natural column order or pointer to ncol (natural, >=1) column numbers in selected order.
+ *               Example: { 1, 7, 5 } will place data from the first column under (*col)[0],
+ *               data from the seventh column under (*col)[1], and data from the fifth column under (*col)[2].
+ *
+ *  @return 0 (OK), -1 (memory error), -2 (invalid parameter),
+ *              -3 (asking for too many columns), -4 (too many rows of data, stopped reading).
+ */
+
+int read_table_v (const char *fname, FILE *fptr, size_t *nrow, size_t ncol, double ***col, const size_t *selcol);
+
+int read_table_v (const char *fname, FILE *fptr, size_t *nrow, size_t ncol, double ***col, const size_t *selcol)
+{
+   char line[10240]; /* Only its size is used: lines are cut into pieces as by fgets() with this buffer */
+   size_t astep = 50, arow = 0;
+   size_t iline = 0, icol, maxcol = ncol, maxrow = 100000;
+   size_t arow_ini = 0; /* First need to check pointers before setting this */
+   double *rval = NULL;
+   size_t *rcol = NULL;
+   int rc = 0;
+   struct rpol_text txt;
+   struct rpol_read_chunk chunk[RPOL_READ_MAX_THREADS];
+   int ic, nch;
+
+   if ( fname == NULL || nrow == NULL || ncol < 1 || col == NULL || *col != NULL )
+   {
+      fprintf(stderr,"read_table_v(%s,...): invalid parameter(s)\n", fname);
+      if ( nrow != NULL )
+         *nrow = 0;
+      return -2;
+   }
+
+   /* Don't trust in large numbers and ignore zero or negative numbers */
+   arow_ini = (*nrow > 2000) ? 2000 : ( (*nrow <= 0) ? astep : *nrow );
+   if ( arow_ini <= 10 )
+      astep = 10;
+   /* Reset any number to be returned. */
+   *nrow = 0;
+
+   /* Other than natural order of columns requested ? */
+   if ( selcol != NULL )
+   {
+      for ( icol=0; icol<ncol; icol++ )
+      {
+         if ( selcol[icol] == 0 )
+         {
+            fprintf(stderr,"Column numbers must start at 1.\n");
+            return -3;
+         }
+         if ( selcol[icol] > maxcol )
+            maxcol = selcol[icol];
+      }
+   }
+   if ( maxcol > 500 )
+   {
+      fprintf(stderr,"read_table_v(%s,...): Non-plausible columns requested\n", fname);
       return -2;
    }
 
@@ -417,93 +920,90 @@ int read_table_v (const char *fname, FILE *fptr, size_t *nrow, size_t ncol, doub
       }
    }
 
-   if ( fptr != NULL )
-      f = fptr;
-   else if ( (f = fileopen(fname,"r")) == NULL )
+   if ( (rc = rpol_text_load(fname, fptr, &txt)) != 0 )
    {
-      perror(fname);
+      free(rval);
+      free(rcol);
       return -1;
    }
-   
-   rc = 0;
 
-   while ( fgets(line,sizeof(line)-1,f) != NULL )
+   memset(chunk, 0, sizeof(chunk));
+   for ( ic=0; ic<RPOL_READ_MAX_THREADS; ic++ )
    {
-      size_t nc = 0;
-      iline++;
-      strip_comments(line);
-
-      if ( line[0] == '\0' )
-      	 continue;
-
-      s = line;
-      while ( *s == ' ' || *s == '\t' )
-         s++;
+      chunk[ic].lsize = sizeof(line);
+      chunk[ic].ncol = (int) ncol;
+      chunk[ic].vmode = 1;
+      chunk[ic].maxcol = maxcol;
+      chunk[ic].rcol = rcol;
+      chunk[ic].selcol = selcol;
+      chunk[ic].maxrows = maxrow;
+   }
+   nch = (txt.len > 0) ? rpol_parse_text(&txt, chunk) : 0;
 
-      for ( ipos=0, nc=0; nc<maxcol && s[ipos] != '\0' && 
-            getword(s,&ipos,word,sizeof(word)-1,' ','#') > 0; nc++ )
+   /* Collect rows and messages in file order */
+   for ( ic=0; ic<nch && rc==0; ic++ )
+   {
+      struct rpol_read_chunk *c = &chunk[ic];
+      size_t i, im = 0;
+      if ( c->nomem )
       {
-         if ( rcol[nc] == 0 )
-            continue; /* Unused column, rval value never filled. */
-         if ( sscanf(word, "%lf", &rval[nc]) == 0 )
-         {
-            rval[nc] = 0.;
-            fprintf(stderr,"File %s line %zu column %zu: Missing or invalid data.\n", fname, iline, nc+1);
-            break;
-         }
+         rc = -1;
+         break;
       }
-      if ( nc == 0 ) /* No data in line: continue quietly */
-         continue;
-      else if ( nc < maxcol ) /* Some data but not enough: complain and continue without the data */
+      for ( i=0; i<=c->nrows; i++ )
       {
-         fprintf(stderr,"File %s line %zu: expected %zu columns but got only %zu.\n",
-            fname, iline, maxcol, nc);
-         continue;
-      }
+         /* Messages from lines before this row */
+         for ( ; im<c->nmsg && c->msg[im].rows == i; im++ )
+         {
+            if ( c->msg[im].type == 1 )
+               fprintf(stderr,"File %s line %zu column %zu: Missing or invalid data.\n",
+                  fname, iline+c->msg[im].iline, c->msg[im].nc);
+            else
+               fprintf(stderr,"File %s line %zu: expected %zu columns but got only %zu.\n",
+                  fname, iline+c->msg[im].iline, maxcol, c->msg[im].nc);
+         }
+         if ( i == c->nrows )
+            break;
 
-      /* Space for more rows needed? */
-      if ( (*nrow) >= arow )
-      {
-         if ( astep*8 < arow )
-            astep *= 2;  /* Less frequent re-allocations if we already have many rows */
-         for ( icol=0; icol<ncol; icol++ )
+         /* Space for more rows needed? */
+         if ( (*nrow) >= arow )
          {
-            double *p = (double *) realloc((*col)[icol],(arow+astep)*sizeof(double));
-            if ( p == NULL ) /* If re-allocation fails for any column, keep what we got so far and stop */
+            if ( astep*8 < arow )
+               astep *= 2;  /* Less frequent re-allocations if we already have many rows */
+            for ( icol=0; icol<ncol; icol++ )
             {
-               rc = -1; /* failure indicator */
-               break;
+               double *p = (double *) realloc((*col)[icol],(arow+astep)*sizeof(double));
+               if ( p == NULL ) /* If re-allocation fails for any column, keep what we got so far and stop */
+               {
+                  rc = -1; /* failure indicator */
+                  break;
+               }
+               (*col)[icol] = p; /* replace column pointer with re-allocated pointer */
             }
-            (*col)[icol] = p; /* replace column pointer with re-allocated pointer */
+            arow += astep;
          }
-         arow += astep;
-      }
-      if ( rc != 0 ) /* Cannot continue after allocation error (but keep data read so far). */
-         break;
+         if ( rc != 0 ) /* Cannot continue after allocation error (but keep data read so far). */
+            break;
 
-      /* Copy from temporary vector to final location */
-      for ( icol=0; icol<ncol; icol++ )
-      {
-         if ( selcol == NULL )
-            (*col)[icol][*nrow] = rval[icol]; /* Natural column order */
-         else
-            (*col)[icol][*nrow] = rval[selcol[icol]-1]; /* Selected column order */
-      }
-      /* Ready for next row */
-      (*nrow)++;
+         /* Copy from the parsed rows (already in selected column order) to final location */
+         for ( icol=0; icol<ncol; icol++ )
+            (*col)[icol][*nrow] = c->val[i*ncol+icol];
+         /* Ready for next row */
+         (*nrow)++;
 
-      /* Despite dynamic allocation there is a point where we stop reading more data */
-      if ( (*nrow) >= maxrow )
-      {
-         rc = -4;
-         fprintf(stderr,"File %s has too many rows. Ignoring the rest.\n", fname);
-         break;
+         /* Despite dynamic allocation there is a point where we stop reading more data */
+         if ( (*nrow) >= maxrow )
+         {
+            rc = -4;
+            fprintf(stderr,"File %s has too many rows. Ignoring the rest.\n", fname);
+            break;
+         }
       }
+      iline += c->nlines;
    }
 
-   /* Close input file if it was opened by this function */
-   if ( fptr == NULL && f != NULL && f != stdin )
-      fileclose(f);
+   rpol_free_chunks(chunk, nch);
+   rpol_text_free(&txt);
 
    /* Free local temporary data. */
    free(rval);
@@ -532,6 +1032,27 @@ struct rpt_list
 };
 static struct rpt_list *rpt_list_base;
 
+static int rpol_is_in_cache (const struct rpol_table *rpt, const void *p);
+static void rpol_cache_unmap (struct rpol_table *rpt);
+
+/* Tables can be shared between threads: the list of loaded tables is
+   protected by a mutex, use counts are changed atomically, and the only
+   change to a table after loading it (cubic spline parameters requested
+   for a table set up for another scheme) is done once under the lock.
+   Compile with -DRPOL_NO_THREADS where pthreads are not available. */
+
+#ifndef RPOL_NO_THREADS
+# include <pthread.h>
+static pthread_mutex_t rpol_lock = PTHREAD_MUTEX_INITIALIZER;
+# define RPOL_LOCK() pthread_mutex_lock(&rpol_lock)
+# define RPOL_UNLOCK() pthread_mutex_unlock(&rpol_lock)
+#else
+# define RPOL_LOCK()
+# define RPOL_UNLOCK()
+#endif
+
+static void rpol_free_nolock (struct rpol_table *rpt, int removing);
+
 struct rpol_table *read_rpol_table (const char *fn, int nd, const char *ymarker, const char *options);
 
 /** 
@@ -776,22 +1297,45 @@ void rpol_info_lvl (struct rpol_table *rpt, int lvl)
 void rpol_free (struct rpol_table *rpt, int removing);
 
 void rpol_free (struct rpol_table *rpt, int removing)
+{
+   RPOL_LOCK();
+   rpol_free_nolock(rpt, removing);
+   RPOL_UNLOCK();
+}
+
+static void rpol_free_nolock (struct rpol_table *rpt, int removing)
 {
    struct rpt_list *rptl, *rptl_n;
+   int uc, i;
 
    if ( rpt == (struct rpol_table *) NULL )
       return;
 
    /* Do nothing but decrement use counter if it seems to be in multiple use */
-   if ( rpt->use_count > 1 )
+   uc = RPOL_ATOMIC_LOAD(&rpt->use_count);
+   if ( uc == 0 )
    {
-      rpt->use_count--;
+      fprintf(stderr,"Trying to free a rpol table that should already be cleared.\n");
       return;
    }
-   else if ( rpt->use_count == 0 )
-   {
-      fprintf(stderr,"Trying to free a rpol table that should already be cleared.\n");
+   else if ( uc > 0 && RPOL_ATOMIC_ADD(&rpt->use_count, -1) > 0 )
       return;
+
+   /* Arrays used in place from a cache file are not to be freed individually. */
+   if ( rpt->cache_map != NULL )
+   {
+      if ( rpol_is_in_cache(rpt, rpt->x) )
+         rpt->x = NULL;
+      if ( rpol_is_in_cache(rpt, rpt->y) )
+         rpt->y = NULL;
+      if ( rpol_is_in_cache(rpt, rpt->z) )
+         rpt->z = NULL;
+      if ( rpol_is_in_cache(rpt, rpt->zxmax) )
+         rpt->zxmax = NULL;
+      if ( rpol_is_in_cache(rpt, rpt->zxmin) )
+         rpt->zxmin = NULL;
+      if ( rpol_is_in_cache(rpt, rpt->csp) )
+         rpt->csp = NULL;
    }
 
    /* Free any allocated parts in the struct */
@@ -837,6 +1381,20 @@ void rpol_free (struct rpol_table *rpt, int removing)
       free(rpt->csp);
       rpt->csp = NULL;
    }
+   for ( i=0; i<2; i++ )
+   {
+      if ( rpt->csp_type[i] != NULL )
+      {
+         free(rpt->csp_type[i]);
+         rpt->csp_type[i] = NULL;
+      }
+      rpt->csp_once[i] = 0;
+   }
+   rpol_free_accel(rpt->xacc);
+   rpt->xacc = NULL;
+   rpol_free_accel(rpt->yacc);
+   rpt->yacc = NULL;
+   rpol_cache_unmap(rpt);
 
    /* We should also remove it from the global linked
       list of interpolation tables, if it is there. */
@@ -881,9 +1439,6 @@ void rpol_free (struct rpol_table *rpt, int removing)
          }
       }
    }
-   
-   if ( rpt->use_count > 0 )
-      rpt->use_count--;
 
    if ( removing )
    {
@@ -893,37 +1448,181 @@ void rpol_free (struct rpol_table *rpt, int removing)
    }
 }
 
-void rpol_check_equi_range(struct rpol_table *rpt);
+/* ------------------------------ rpol_share ------------------------------- */
+/**
+ *  @short Register one more user of a table, e.g. before handing it to
+ *     another thread, which then releases it with rpol_free(rpt,0).
+ *     Tables for local use only (use count -1) are returned unchanged.
+ */
 
-void rpol_check_equi_range(struct rpol_table *rpt)
+struct rpol_table *rpol_share (struct rpol_table *rpt)
 {
-   size_t i, j;
-   int xrise = 0, yrise = 0;
-   size_t nz = 0;
+   if ( rpt != NULL && RPOL_ATOMIC_LOAD(&rpt->use_count) > 0 )
+      RPOL_ATOMIC_ADD(&rpt->use_count, 1);
+   return rpt;
+}
 
-   if ( rpt == NULL )
-      return;
-   rpt->equidistant = 0;
+/* ================================================================== */
+/*
+   Bucket index for O(1) interval search in non-equidistant tables.
+   The range [v[0],v[n-1]] is divided into nb equal buckets, each knowing
+   the interval index for its lower end. A lookup is then a direct bucket
+   access plus a short forward scan within the bucket.
+   The index is set up in rpol_check_equi_range() (for tables with at
+   least rpol_accel_min supporting points) and never modified afterwards,
+   so any number of threads can use it at the same time.
+*/
 
-   if ( rpt->x == NULL || rpt->z == NULL ||
-        (rpt->ndim >= 2 && rpt->y == NULL ) )
-      return;
-   if ( rpt->nx < 1 || (rpt->ndim >= 2 && rpt->ny < 1 ) )
-      return;
+#ifndef RPOL_ACCEL_MIN_SIZE
+# define RPOL_ACCEL_MIN_SIZE 32
+#endif
 
-   /* The number of z values in this table */
-   nz = rpt->nx;
-   if ( rpt->ndim > 1 )
-      nz *= rpt->ny;
+static size_t rpol_accel_min = RPOL_ACCEL_MIN_SIZE;
 
-   /* Auto-revert 1-D tables with descending x values. */
-   if ( rpt->ndim == 1 && rpt->nx > 1 && rpt->x[rpt->nx-1] < rpt->x[0] )
-   {
-      /* Reverse the order of the table */
-      double xt, zt;
-      for ( i=0; i<rpt->nx/2; i++) /* Leave out the middle one of an odd number of entries */
-      {
-         xt = rpt->x[i];
+/**
+ *  @short Set the minimum number of supporting points for which tables 
+ *     loaded afterwards get a bucket index (0: never). Returns the old value.
+ */
+
+size_t rpol_set_accel_min(size_t n)
+{
+   size_t old = rpol_accel_min;
+   rpol_accel_min = n;
+   return old;
+}
+
+static inline size_t accel_bucket (const RpolAccel *acc, double xp)
+{
+   double u = (xp - acc->x0) * acc->dxi;
+   if ( !(u > 0.) )
+      return 0;
+   if ( u >= (double) acc->nb )
+      return acc->nb-1;
+   return (size_t) u;
+}
+
+/* --------------------------- rpol_build_accel ------------------------------- */
+/**
+ *  @short Set up a bucket index for the strictly ascending supporting points v.
+ *
+ *  @return Allocated index (free with rpol_free_accel()) or NULL if not applicable.
+ */
+
+RpolAccel *rpol_build_accel (const double *v, size_t n)
+{
+   RpolAccel *acc;
+   size_t i, b;
+
+   if ( v == NULL || n < 3 || !(v[n-1] > v[0]) )
+      return NULL;
+   for ( i=1; i<n; i++ )
+      if ( !(v[i] > v[i-1]) )
+         return NULL;
+
+   if ( (acc = (RpolAccel *) calloc(1,sizeof(RpolAccel))) == NULL )
+      return NULL;
+   acc->nb = 2*(n-1);
+   acc->x0 = v[0];
+   acc->dxi = (double) acc->nb / (v[n-1] - v[0]);
+   if ( (acc->first = (int *) calloc(acc->nb+1,sizeof(int))) == NULL )
+   {
+      free(acc);
+      return NULL;
+   }
+   /* first[b] = 1 + number of inner points in buckets below b, 
+      which are all below any coordinate falling into bucket b. */
+   for ( i=1; i<n-1; i++ )
+      acc->first[accel_bucket(acc,v[i])+1]++;
+   acc->first[0] = 1;
+   for ( b=1; b<=acc->nb; b++ )
+      acc->first[b] += acc->first[b-1];
+
+   return acc;
+}
+
+void rpol_free_accel (RpolAccel *acc)
+{
+   if ( acc == NULL )
+      return;
+   free(acc->first);
+   free(acc);
+}
+
+/* Same result as the binary search in locate_batch(): 1 + number of inner
+   supporting points below xp, for xp within [v[0],v[n-1]]. Only the inner
+   points within the bucket of xp remain to be searched (usually none or one). */
+
+static inline int accel_ipl (const RpolAccel *acc, const double *v, double xp)
+{
+   size_t b = accel_bucket(acc,xp);
+   int j = acc->first[b], len = acc->first[b+1] - j;
+   while ( len > 0 )
+   {
+      int half = len / 2;
+      if ( v[j+half] < xp )
+      {
+         j += half + 1;
+         len -= half + 1;
+      }
+      else
+         len = half;
+   }
+   return j;
+}
+
+/* (Re-)build or drop the bucket indices of a table after its supporting points changed. */
+
+static void rpol_update_accel (struct rpol_table *rpt)
+{
+   rpol_free_accel(rpt->xacc);
+   rpt->xacc = NULL;
+   rpol_free_accel(rpt->yacc);
+   rpt->yacc = NULL;
+
+   if ( rpol_accel_min == 0 || rpt->scheme == -3 )
+      return;
+   if ( !(rpt->equidistant & 1) && rpt->nx >= rpol_accel_min && rpt->xrise == 1 )
+      rpt->xacc = rpol_build_accel(rpt->x, rpt->nx);
+   if ( (rpt->ndim == 2 || rpt->ndim == 3) && !(rpt->equidistant & 2) &&
+        rpt->ny >= rpol_accel_min && rpt->yrise == 1 )
+      rpt->yacc = rpol_build_accel(rpt->y, rpt->ny);
+}
+
+void rpol_check_equi_range(struct rpol_table *rpt);
+
+void rpol_check_equi_range(struct rpol_table *rpt)
+{
+   size_t i, j;
+   int xrise = 0, yrise = 0;
+   size_t nz = 0;
+
+   if ( rpt == NULL )
+      return;
+   rpt->equidistant = 0;
+   rpol_free_accel(rpt->xacc);
+   rpt->xacc = NULL;
+   rpol_free_accel(rpt->yacc);
+   rpt->yacc = NULL;
+
+   if ( rpt->x == NULL || rpt->z == NULL ||
+        (rpt->ndim >= 2 && rpt->y == NULL ) )
+      return;
+   if ( rpt->nx < 1 || (rpt->ndim >= 2 && rpt->ny < 1 ) )
+      return;
+
+   /* The number of z values in this table */
+   nz = rpt->nx;
+   if ( rpt->ndim > 1 )
+      nz *= rpt->ny;
+
+   /* Auto-revert 1-D tables with descending x values. */
+   if ( rpt->ndim == 1 && rpt->nx > 1 && rpt->x[rpt->nx-1] < rpt->x[0] )
+   {
+      /* Reverse the order of the table */
+      double xt, zt;
+      for ( i=0; i<rpt->nx/2; i++) /* Leave out the middle one of an odd number of entries */
+      {
+         xt = rpt->x[i];
          zt = rpt->z[i];
          rpt->x[i] = rpt->x[rpt->nx-1-i];
          rpt->z[i] = rpt->z[rpt->nx-1-i];
@@ -1081,8 +1780,341 @@ void rpol_check_equi_range(struct rpol_table *rpt)
          }
       }
    }
+
+   /* Bucket index for larger non-equidistant tables, also to be redone after remapping. */
+   rpol_update_accel(rpt);
+}
+
+/* ================================================================== */
+/*
+   Binary cache of parsed tables. If the environment variable RPOL_CACHE
+   names a directory, each table loaded by read_rpol_table() from a text
+   file is also written there in its final form (after log/scale options,
+   equidistance check and cubic spline set-up). Later loads of the same
+   file with the same options map the cache file instead of parsing the text.
+   A cache file is only used if version, table name (incl. options), size
+   and modification time of the source file, and a checksum over the data
+   all match; otherwise the table is parsed again and the cache rewritten.
+   The arrays are used in place from a private (copy-on-write) mapping.
+*/
+
+#ifndef RPOL_NO_CACHE
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#define RPOL_CACHE_VERSION 1
+
+struct rpol_cache_header
+{
+   char magic[8];          /* "RPOLCACH" */
+   uint32_t version;
+   uint32_t header_size;
+   uint64_t total_size;
+   uint64_t checksum;      /* FNV-1a over everything after the header */
+   uint64_t src_size;      /* Source text file size and modification time */
+   int64_t src_mtime, src_mtime_ns;
+   int32_t ndim, equidistant, scheme, clipping, zxreq, logs, xlog, ylog, zlog;
+   int32_t have_y;         /* 0: no y, 1: own y values, 2: y same as z */
+   int32_t have_zxmax, have_zxmin, have_csp, pad;
+   uint64_t nx, ny;
+   double aux, xmin, xmax, dx, dxi, xrise, ymin, ymax, dy, dyi, yrise, zmin, zmax;
+   uint64_t off_fname, off_options, off_x, off_y, off_z, off_zxmax, off_zxmin, off_csp;
+};
+
+static uint64_t rpol_fnv1a (const unsigned char *p, size_t n)
+{
+   uint64_t h = 14695981039346656037ULL;
+   size_t i;
+   for ( i=0; i<n; i++ )
+   {
+      h ^= p[i];
+      h *= 1099511628211ULL;
+   }
+   return h;
+}
+
+/* Cache file name for a table name (incl. options), or 0 if no caching. */
+
+static int rpol_cache_name (const char *fnplus, char *cname, size_t len)
+{
+   const char *dir = getenv("RPOL_CACHE");
+   if ( dir == NULL || *dir == '\0' )
+      return 0;
+   snprintf(cname, len, "%s/%016llx.rpolc", dir,
+      (unsigned long long) rpol_fnv1a((const unsigned char *) fnplus, strlen(fnplus)));
+   return 1;
+}
+
+static size_t rpol_align8 (size_t n)
+{
+   return (n + 7) & ~((size_t) 7);
+}
+
+static int rpol_is_in_cache (const struct rpol_table *rpt, const void *p)
+{
+   return ( rpt->cache_map != NULL && p != NULL &&
+            (const char *) p >= (const char *) rpt->cache_map &&
+            (const char *) p < (const char *) rpt->cache_map + rpt->cache_len );
+}
+
+static void rpol_cache_unmap (struct rpol_table *rpt)
+{
+   if ( rpt->cache_map != NULL )
+      munmap(rpt->cache_map, rpt->cache_len);
+   rpt->cache_map = NULL;
+   rpt->cache_len = 0;
+}
+
+/* --------------------------- rpol_cache_load ------------------------------- */
+/**
+ *  @short Try to map a cached table for the given table name and source file.
+ *
+ *  @return New table (not yet registered) or NULL if no usable cache exists.
+ */
+
+static struct rpol_table *rpol_cache_load (const char *fnplus, const char *fnclean)
+{
+   char cname[4200];
+   struct stat st_src, st;
+   struct rpol_cache_header *h;
+   struct rpol_table *rpt;
+   char *map;
+   int fd;
+
+   if ( !rpol_cache_name(fnplus, cname, sizeof(cname)) )
+      return NULL;
+   if ( stat(fnclean, &st_src) != 0 )
+      return NULL;
+   if ( (fd = open(cname, O_RDONLY)) < 0 )
+      return NULL;
+   if ( fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(struct rpol_cache_header) )
+   {
+      close(fd);
+      return NULL;
+   }
+   map = (char *) mmap(NULL, (size_t) st.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if ( map == (char *) MAP_FAILED )
+      return NULL;
+
+   h = (struct rpol_cache_header *) map;
+   if ( memcmp(h->magic, "RPOLCACH", 8) != 0 || 
+        h->version != RPOL_CACHE_VERSION ||
+        h->header_size != sizeof(struct rpol_cache_header) ||
+        h->total_size != (uint64_t) st.st_size ||
+        h->src_size != (uint64_t) st_src.st_size ||
+        h->src_mtime != (int64_t) st_src.st_mtim.tv_sec ||
+        h->src_mtime_ns != (int64_t) st_src.st_mtim.tv_nsec ||
+        h->off_fname >= h->total_size ||
+        strncmp(map + h->off_fname, fnplus, h->total_size - h->off_fname) != 0 ||
+        rpol_fnv1a((unsigned char *) map + sizeof(*h), h->total_size - sizeof(*h)) != h->checksum )
+   {
+      if ( rpol_verbosity >= 2 )
+         printf("Cached table %s for '%s' is outdated.\n", cname, fnplus);
+      munmap(map, (size_t) st.st_size);
+      return NULL;
+   }
+
+   if ( (rpt = (struct rpol_table *) calloc(1,sizeof(struct rpol_table))) == NULL )
+   {
+      munmap(map, (size_t) st.st_size);
+      return NULL;
+   }
+   rpt->cache_map = map;
+   rpt->cache_len = (size_t) st.st_size;
+   rpt->ndim = h->ndim;
+   rpt->nx = (size_t) h->nx;
+   rpt->ny = (size_t) h->ny;
+   rpt->x = (double *) (map + h->off_x);
+   rpt->z = (double *) (map + h->off_z);
+   if ( h->have_y == 1 )
+      rpt->y = (double *) (map + h->off_y);
+   else if ( h->have_y == 2 )
+      rpt->y = rpt->z;
+   if ( h->have_zxmax )
+      rpt->zxmax = (double *) (map + h->off_zxmax);
+   if ( h->have_zxmin )
+      rpt->zxmin = (double *) (map + h->off_zxmin);
+   if ( h->have_csp )
+      rpt->csp = (CsplinePar *) (map + h->off_csp);
+   rpt->aux = h->aux;
+   rpt->xmin = h->xmin;
+   rpt->xmax = h->xmax;
+   rpt->dx = h->dx;
+   rpt->dxi = h->dxi;
+   rpt->xrise = h->xrise;
+   rpt->ymin = h->ymin;
+   rpt->ymax = h->ymax;
+   rpt->dy = h->dy;
+   rpt->dyi = h->dyi;
+   rpt->yrise = h->yrise;
+   rpt->zmin = h->zmin;
+   rpt->zmax = h->zmax;
+   rpt->fname = strdup(map + h->off_fname);
+   if ( h->off_options != 0 )
+      rpt->options = strdup(map + h->off_options);
+   rpt->equidistant = h->equidistant;
+   rpt->scheme = h->scheme;
+   rpt->clipping = h->clipping;
+   rpt->zxreq = h->zxreq;
+   rpt->logs = h->logs;
+   rpt->xlog = h->xlog;
+   rpt->ylog = h->ylog;
+   rpt->zlog = h->zlog;
+   rpt->use_count = 1;
+   rpol_update_accel(rpt);
+
+   if ( rpol_verbosity >= 2 )
+      printf("Table '%s' mapped from cache %s.\n", fnplus, cname);
+   return rpt;
+}
+
+/* --------------------------- rpol_cache_save ------------------------------- */
+/**
+ *  @short Write a freshly parsed table to the cache (if enabled).
+ *     The file is written under a temporary name and renamed when complete.
+ */
+
+static void rpol_cache_save (const struct rpol_table *rpt, const char *fnclean)
+{
+   char cname[4200], tname[4300];
+   struct stat st_src;
+   struct rpol_cache_header h;
+   size_t nz, off, lx, ly, lz, lzx, lcsp, lf, lo;
+   char *buf;
+   FILE *f;
+   int ok;
+
+   if ( rpt == NULL || rpt->fname == NULL || rpt->x == NULL || rpt->z == NULL )
+      return;
+   if ( !rpol_cache_name(rpt->fname, cname, sizeof(cname)) )
+      return;
+   if ( stat(fnclean, &st_src) != 0 || !S_ISREG(st_src.st_mode) )
+      return;
+
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, "RPOLCACH", 8);
+   h.version = RPOL_CACHE_VERSION;
+   h.header_size = sizeof(h);
+   h.src_size = (uint64_t) st_src.st_size;
+   h.src_mtime = (int64_t) st_src.st_mtim.tv_sec;
+   h.src_mtime_ns = (int64_t) st_src.st_mtim.tv_nsec;
+   h.ndim = rpt->ndim;
+   h.equidistant = rpt->equidistant;
+   h.scheme = rpt->scheme;
+   h.clipping = rpt->clipping;
+   h.zxreq = rpt->zxreq;
+   h.logs = rpt->logs;
+   h.xlog = rpt->xlog;
+   h.ylog = rpt->ylog;
+   h.zlog = rpt->zlog;
+   h.nx = rpt->nx;
+   h.ny = rpt->ny;
+   h.aux = rpt->aux;
+   h.xmin = rpt->xmin;
+   h.xmax = rpt->xmax;
+   h.dx = rpt->dx;
+   h.dxi = rpt->dxi;
+   h.xrise = rpt->xrise;
+   h.ymin = rpt->ymin;
+   h.ymax = rpt->ymax;
+   h.dy = rpt->dy;
+   h.dyi = rpt->dyi;
+   h.yrise = rpt->yrise;
+   h.zmin = rpt->zmin;
+   h.zmax = rpt->zmax;
+
+   nz = rpt->nx;
+   if ( rpt->ndim > 1 )
+      nz *= rpt->ny;
+   h.have_y = (rpt->y == NULL) ? 0 : ((rpt->y == rpt->z) ? 2 : 1);
+   h.have_zxmax = (rpt->zxmax != NULL);
+   h.have_zxmin = (rpt->zxmin != NULL);
+   h.have_csp = (rpt->csp != NULL);
+   lf = strlen(rpt->fname) + 1;
+   lo = (rpt->options != NULL) ? strlen(rpt->options) + 1 : 0;
+   lx = rpt->nx * sizeof(double);
+   ly = (h.have_y == 1) ? rpt->ny * sizeof(double) : 0;
+   lz = nz * sizeof(double);
+   lzx = rpt->nx * sizeof(double);
+   lcsp = h.have_csp ? rpt->nx * sizeof(CsplinePar) : 0;
+
+   /* All sections 8-byte aligned, arrays first */
+   off = rpol_align8(sizeof(h));
+   h.off_x = off;   off = rpol_align8(off + lx);
+   h.off_y = ly ? off : 0;   off = rpol_align8(off + ly);
+   h.off_z = off;   off = rpol_align8(off + lz);
+   h.off_zxmax = h.have_zxmax ? off : 0;   off = rpol_align8(off + (h.have_zxmax ? lzx : 0));
+   h.off_zxmin = h.have_zxmin ? off : 0;   off = rpol_align8(off + (h.have_zxmin ? lzx : 0));
+   h.off_csp = lcsp ? off : 0;   off = rpol_align8(off + lcsp);
+   h.off_options = lo ? off : 0;   off = rpol_align8(off + lo);
+   h.off_fname = off;   off += lf;
+   h.total_size = off;
+
+   if ( (buf = (char *) calloc(1, off)) == NULL )
+      return;
+   memcpy(buf + h.off_x, rpt->x, lx);
+   if ( ly )
+      memcpy(buf + h.off_y, rpt->y, ly);
+   memcpy(buf + h.off_z, rpt->z, lz);
+   if ( h.have_zxmax )
+      memcpy(buf + h.off_zxmax, rpt->zxmax, lzx);
+   if ( h.have_zxmin )
+      memcpy(buf + h.off_zxmin, rpt->zxmin, lzx);
+   if ( lcsp )
+      memcpy(buf + h.off_csp, rpt->csp, lcsp);
+   if ( lo )
+      memcpy(buf + h.off_options, rpt->options, lo);
+   memcpy(buf + h.off_fname, rpt->fname, lf);
+   h.checksum = rpol_fnv1a((unsigned char *) buf + sizeof(h), off - sizeof(h));
+   memcpy(buf, &h, sizeof(h));
+
+   snprintf(tname, sizeof(tname), "%s.%ld.tmp", cname, (long) getpid());
+   ok = 0;
+   if ( (f = fopen(tname, "wb")) != NULL )
+   {
+      ok = (fwrite(buf, 1, off, f) == off);
+      if ( fclose(f) != 0 )
+         ok = 0;
+      if ( ok && rename(tname, cname) != 0 )
+         ok = 0;
+      if ( !ok )
+         unlink(tname);
+   }
+   if ( !ok && rpol_verbosity > 0 )
+      fprintf(stderr, "Could not write table cache %s\n", cname);
+   else if ( ok && rpol_verbosity >= 2 )
+      printf("Table '%s' written to cache %s.\n", rpt->fname, cname);
+   free(buf);
+}
+
+#else
+
+static struct rpol_table *rpol_cache_load (const char *fnplus, const char *fnclean)
+{
+   return NULL;
+}
+
+static void rpol_cache_save (const struct rpol_table *rpt, const char *fnclean)
+{
+}
+
+static int rpol_is_in_cache (const struct rpol_table *rpt, const void *p)
+{
+   return 0;
+}
+
+static void rpol_cache_unmap (struct rpol_table *rpt)
+{
 }
 
+#endif
+
 /**
  *  @short General function for loading interpolation table combines 1-D and 2-D grid case. 
  *
@@ -1098,7 +2130,20 @@ void rpol_check_equi_range(struct rpol_table *rpt)
  *                 with nd=2 only (otherwise ignored).
  */
 
+static struct rpol_table *read_rpol_table_nolock (const char *fname, int nd, const char *ymarker, const char *options);
+
 struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymarker, const char *options)
+{
+   struct rpol_table *rpt;
+
+   /* One thread at a time, so that a table requested by several threads is loaded only once. */
+   RPOL_LOCK();
+   rpt = read_rpol_table_nolock(fname, nd, ymarker, options);
+   RPOL_UNLOCK();
+   return rpt;
+}
+
+static struct rpol_table *read_rpol_table_nolock (const char *fname, int nd, const char *ymarker, const char *options)
 {
    struct rpol_table *rpt = NULL;
    struct rpt_list *rptl = NULL;
@@ -1207,10 +2252,23 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
       {
          printf("Interpolation table '%s' already loaded.\n", rptl->rpt->fname);
       }
-      rptl->rpt->use_count++;
+      RPOL_ATOMIC_ADD(&rptl->rpt->use_count, 1);
       return rptl->rpt;
    }
 
+   /* A cached binary image of the same table saves parsing the text file. */
+   if ( (rpt = rpol_cache_load(fnplus, fnclean)) != NULL )
+   {
+      rptl->rpt = rpt;
+      rptl->next = (struct rpt_list *) calloc(1,sizeof(struct rpt_list));
+      if ( rptl->next == NULL )
+      {
+         fprintf(stderr, "rpt_list allocation problem\n");
+         return NULL;
+      }
+      return rpt;
+   }
+
    ymarker_i[0] = '\0';
 
    FILE *f = fileopen(fnclean,"r"); /* Use the cleaned file name (without any '#rpol:...') */
@@ -1585,7 +2643,7 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
          if ( f == NULL )
          {
             perror(fname);
-            rpol_free(rpt,1);
+            rpol_free_nolock(rpt,1);
             return NULL;
          }
       }
@@ -1606,7 +2664,7 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
       if ( (rc < 0 && nrows == 0) || xy == NULL )
       {
          fileclose(f);
-         rpol_free(rpt,1);
+         rpol_free_nolock(rpt,1);
          return NULL;
       }
       
@@ -1666,7 +2724,7 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
       if ( line[0] == '\0' )
       {
          fprintf(stderr,"No suitable header line in table %s.\n", fname);
-         rpol_free(rpt,1);
+         rpol_free_nolock(rpt,1);
          fileclose(f);
       	 return NULL;
       }
@@ -1698,7 +2756,7 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
       if ( (y = (double *) calloc(expect_cols,sizeof(double))) == NULL )
       {
          fprintf(stderr,"rpol_table allocation problem\n");
-         rpol_free(rpt,1);
+         rpol_free_nolock(rpt,1);
          fileclose(f);
       	 return NULL;
       }
@@ -1731,7 +2789,7 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
       {
          free(y);
          fprintf(stderr,"rpol_table allocation problem\n");
-         rpol_free(rpt,1);
+         rpol_free_nolock(rpt,1);
          fileclose(f);
       	 return NULL;
       }
@@ -1749,7 +2807,7 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
          if ( xz != NULL )
             free(xz);
          fileclose(f);
-         rpol_free(rpt,1);
+         rpol_free_nolock(rpt,1);
          return NULL;
       }
       
@@ -1780,7 +2838,7 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
                free(xz[i+1]);
          free(xz);
          fileclose(f);
-         rpol_free(rpt,1);
+         rpol_free_nolock(rpt,1);
          return NULL;
       }
 
@@ -1810,7 +2868,7 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
 
       if ( (rc < 0 && nrows == 0) || xyz == NULL )
       {
-         rpol_free(rpt,1);
+         rpol_free_nolock(rpt,1);
          if ( xyz != NULL )
             free(xyz);
          return NULL;
@@ -1824,7 +2882,7 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
          if ( xyz[2] != NULL )
             free(xyz[2]);
          free(xyz);
-         rpol_free(rpt,1);
+         rpol_free_nolock(rpt,1);
          return NULL;
       }
       
@@ -1907,7 +2965,7 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
          fprintf(stderr,"Invalid order of entries in %s (nx=%ju, ny=%ju, nrows=%ju, xfirst=%d).\n", 
             fnplus, nx, ny, nrows, xfirst);
          free(xyz);
-         rpol_free(rpt,1);
+         rpol_free_nolock(rpt,1);
          return NULL;
       }
       
@@ -1919,7 +2977,7 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
          free(xyz[1]);
          free(xyz[2]);
          free(xyz);
-         rpol_free(rpt,1);
+         rpol_free_nolock(rpt,1);
          return NULL;
       }
       if ( xfirst == 1 )
@@ -2120,6 +3178,8 @@ struct rpol_table *read_rpol_table (const char *fname, int nd, const char *ymark
       }
    }
 
+   rpol_cache_save(rpt, fnclean);
+
    return rpt;
 }
 
@@ -2152,7 +3212,7 @@ struct rpol_table *simple_rpol1d_table(const char *label, double *x, double *y,
    rpt->ny = 0;
    rpt->x = (double *) calloc(rpt->nx,sizeof(double));
    rpt->z = (double *) calloc(rpt->nx,sizeof(double));
-   if ( rpt->x == NULL || rpt->y == NULL )
+   if ( rpt->x == NULL || rpt->z == NULL )
    {
       fprintf(stderr, "rpol_table allocation problem\n");
       return NULL;
@@ -2160,7 +3220,7 @@ struct rpol_table *simple_rpol1d_table(const char *label, double *x, double *y,
    for ( i=0; i<n; i++ )
    {
       rpt->x[i] = x[i];
-      rpt->y[i] = y[i];
+      rpt->z[i] = y[i];
    }
    rpt->fname = strdup(label);
    rpt->scheme = 1; /* linear */
@@ -2944,6 +4004,13 @@ double rpol_2d_linear (double *x, double *y, double *z, int nx, int ny, double x
 
 /* =============== High-level interpolation functions ================ */
 
+/* Batch code (see below), also used for single values in tables with a bucket index. */
+static void rpol_1d_batch_acc (double *x, double *y, const CsplinePar *csp, int n, 
+   const RpolAccel *acc, const double *xp, double *out, size_t np, int eq, int clip, int scheme);
+static void rpol_2d_linear_batch_acc (double *x, double *y, double *z, int nx, int ny, 
+   const RpolAccel *xacc, const RpolAccel *yacc,
+   const double *xp, const double *yp, double *out, size_t np, int eq, int clip);
+
 /* ----------------------------- rpolate_1d ------------------------------- */
 /**
  *  @short High-level interpolation function (user code only has to keep 
@@ -2961,11 +4028,48 @@ double rpol_2d_linear (double *x, double *y, double *z, int nx, int ny, double x
  *      a -1 scheme will interpolate in this upper envelope and -2 the lower envelope.
  */
 
+/* ------------------------------ rpol_get_csp ------------------------------ */
+/**
+ *  @short Cubic spline parameters of a 1-D table for scheme 3 (natural) or
+ *     4 (clamped). The table's own scheme uses the parameters set up when
+ *     loading it; the other type is set up on first use, kept separately
+ *     per type, so the result never depends on which scheme asked first.
+ *     This is the only change to a table after loading it and it is done at
+ *     most once per type, under the lock, so that concurrent readers see
+ *     either NULL or the complete parameters.
+ */
+
+static const CsplinePar *rpol_get_csp (struct rpol_table *rpt, int scheme)
+{
+   int clamped = (scheme == 4);
+   CsplinePar *csp;
+
+   if ( rpt->csp != NULL && (rpt->scheme == 4) == clamped )
+      return rpt->csp;
+   if ( rpt->ndim != 1 || rpt->nx < 4 || rpt->xrise != 1 )
+      return NULL;
+   csp = RPOL_ATOMIC_LOAD(&rpt->csp_type[clamped]);
+   if ( csp != NULL || RPOL_ATOMIC_LOAD(&rpt->csp_once[clamped]) )
+      return csp;
+
+   RPOL_LOCK();
+   if ( (csp = rpt->csp_type[clamped]) == NULL && !rpt->csp_once[clamped] )
+   {
+      csp = set_1d_cubic_params(rpt->x, rpt->z, rpt->nx, clamped);
+      RPOL_ATOMIC_STORE(&rpt->csp_type[clamped], csp);
+      RPOL_ATOMIC_STORE(&rpt->csp_once[clamped], 1);
+   }
+   RPOL_UNLOCK();
+
+   return csp;
+}
+
 double rpolate_1d(struct rpol_table *rpt, double x, int scheme);
 
 double rpolate_1d(struct rpol_table *rpt, double x, int scheme)
 {
    double z = 0.;
+   const CsplinePar *csp = NULL;
 
 #ifdef RPOL_DEBUG
    printf("   rpolate_1d(%p, %g, %d)\n", rpt, x, scheme);
@@ -2994,6 +4098,12 @@ double rpolate_1d(struct rpol_table *rpt, double x, int scheme)
       {
          if ( rpol_verbosity > 3 )
             fprintf(stderr,"Maximum z (along y) value interpolation from 2-D table.\n");
+         if ( rpt->xacc != NULL )
+         {
+            rpol_1d_batch_acc(rpt->x, rpt->zxmax, NULL, (int) rpt->nx, rpt->xacc, &x, &z, 1,
+               (rpt->equidistant & 0x01), rpt->clipping, 1);
+            return rpt->zlog ? exp(z) : z;
+         }
          if ( rpt->zlog )
             return exp(rpol_linear(rpt->x, rpt->zxmax, rpt->nx, x, (rpt->equidistant & 0x01), rpt->clipping));
          else
@@ -3004,6 +4114,12 @@ double rpolate_1d(struct rpol_table *rpt, double x, int scheme)
       {
          if ( rpol_verbosity > 3 )
             fprintf(stderr,"Minimum z (along y) value interpolation from 2-D table.\n");
+         if ( rpt->xacc != NULL )
+         {
+            rpol_1d_batch_acc(rpt->x, rpt->zxmin, NULL, (int) rpt->nx, rpt->xacc, &x, &z, 1,
+               (rpt->equidistant & 0x01), rpt->clipping, 1);
+            return rpt->zlog ? exp(z) : z;
+         }
          if ( rpt->zlog )
             return exp(rpol_linear(rpt->x, rpt->zxmin, rpt->nx, x, (rpt->equidistant & 0x01), rpt->clipping));
          else
@@ -3028,7 +4144,14 @@ double rpolate_1d(struct rpol_table *rpt, double x, int scheme)
       scheme = rpt->scheme;
    }
 
-   switch ( scheme )
+   if ( scheme == 3 || scheme == 4 )
+      csp = rpol_get_csp(rpt, scheme);
+
+   /* With a bucket index, the batch code finds the interval in O(1). */
+   if ( rpt->xacc != NULL && scheme >= 0 && scheme <= 4 && scheme != 2 )
+      rpol_1d_batch_acc(rpt->x, rpt->z, csp, (int) rpt->nx, rpt->xacc, &x, &z, 1,
+         (rpt->equidistant & 0x01), rpt->clipping, scheme);
+   else switch ( scheme )
    {
       case 0: /* zero-order, nearest value */
          z = rpol_nearest(rpt->x, rpt->z, rpt->nx, x, (rpt->equidistant & 0x01), rpt->clipping);
@@ -3041,7 +4164,7 @@ double rpolate_1d(struct rpol_table *rpt, double x, int scheme)
          break;
       case 3: /* Natural cubic spline */
       case 4: /* Clamped cubic spline */
-         z = rpol_cspline(rpt->x, rpt->z, rpt->csp, rpt->nx, x, (rpt->equidistant & 0x01), rpt->clipping);
+         z = rpol_cspline(rpt->x, rpt->z, csp, rpt->nx, x, (rpt->equidistant & 0x01), rpt->clipping);
          break;
       default:
          return 0.;
@@ -3156,7 +4279,11 @@ double rpolate_2d(struct rpol_table *rpt, double x, double y, int scheme)
       case 2: 
       case 3:
       case 4:
-         z = rpol_2d_linear(rpt->x, rpt->y, rpt->z, rpt->nx, rpt->ny, x, y, rpt->equidistant, rpt->clipping);
+         if ( rpt->xacc != NULL || rpt->yacc != NULL )
+            rpol_2d_linear_batch_acc(rpt->x, rpt->y, rpt->z, (int) rpt->nx, (int) rpt->ny,
+               rpt->xacc, rpt->yacc, &x, &y, &z, 1, rpt->equidistant, rpt->clipping);
+         else
+            z = rpol_2d_linear(rpt->x, rpt->y, rpt->z, rpt->nx, rpt->ny, x, y, rpt->equidistant, rpt->clipping);
          break;
       default:
          if ( rpol_verbosity > 0 )
@@ -3215,6 +4342,863 @@ double rpolate(struct rpol_table *rpt, double x, double y, int scheme)
       return rpolate_2d(rpt,x,y,scheme);
 }
 
+/* ==================== Batch interpolation functions ========================= */
+
+/* Values are processed in chunks of this size, with the interval indices
+   and fractions kept in local arrays in between. */
+#ifndef RPOL_BATCH_CHUNK
+# define RPOL_BATCH_CHUNK 256
+#endif
+
+/* --------------------------- locate_batch ------------------------------- */
+/**
+ *  @short Interval index and fraction for many coordinates at once.
+ *
+ *  The coordinates must already be within [v[0],v[n-1]] and v be in
+ *  strictly ascending order. Same conventions as for interp():
+ *  1 <= ipl <= n-1 and 0 <= rpl <= 1. For equidistant tables the
+ *  index is computed directly, for others the bucket index is used
+ *  if available, or else a binary search with a fixed number of steps
+ *  and conditional moves instead of branches.
+ */
+
+static void locate_batch (const double *v, int n, const RpolAccel *acc, 
+   const double *xp, size_t np, int eq, int *ipl, double *rpl);
+
+static void locate_batch (const double *v, int n, const RpolAccel *acc, 
+   const double *xp, size_t np, int eq, int *ipl, double *rpl)
+{
+   size_t i;
+
+   if ( eq )
+   {
+      double x0 = v[0], dxi = 1./(v[1] - v[0]);
+      for ( i=0; i<np; i++ )
+      {
+         int j = (int) ((xp[i]-x0)*dxi) + 1;
+         j = (j > n-1) ? n-1 : j; /* Could happen with rounding errors */
+         ipl[i] = j;
+         rpl[i] = (xp[i]-v[j-1])*dxi;
+      }
+   }
+   else if ( acc != NULL )
+   {
+      for ( i=0; i<np; i++ )
+      {
+         int j = accel_ipl(acc, v, xp[i]);
+         ipl[i] = j;
+         rpl[i] = (v[j] != v[j-1]) ? (xp[i]-v[j-1])/(v[j]-v[j-1]) : 0.5;
+      }
+   }
+   else
+   {
+      for ( i=0; i<np; i++ )
+      {
+         /* Last supporting point below xp (or the first one) */
+         const double *base = v;
+         int len = n;
+         while ( len > 1 )
+         {
+            int half = len / 2;
+            base = (base[half] < xp[i]) ? base + half : base;
+            len -= half;
+         }
+         int j = (int) (base - v) + 1;
+         j = (j > n-1) ? n-1 : j;
+         ipl[i] = j;
+         rpl[i] = (v[j] != v[j-1]) ? (xp[i]-v[j-1])/(v[j]-v[j-1]) : 0.5;
+      }
+   }
+}
+
+/* ----------------------------- rpol_1d_batch ------------------------------- */
+/**
+ *  @short Interpolation in 1-D for many coordinates at once.
+ *
+ *  Equivalent to calling rpol_nearest(), rpol_linear(), rpol_2nd_order()
+ *  or rpol_cspline() for each of the coordinates, but with the
+ *  scheme and range checks resolved once and tight loops over the values.
+ *  Results are identical, except that cubic splines may differ in the
+ *  last bit for coordinates exactly on a supporting point of a
+ *  non-equidistant table (the spline is then evaluated at the end of
+ *  the interval below rather than at the start of the one above).
+ *  The 2nd order scheme is evaluated value by value.
+ *
+ *  @param   x      Input: Coordinates for data table
+ *  @param   y      Input: Corresponding values for data table
+ *  @param   csp    Input: Cubic spline parameters (scheme 3 and 4 only, else NULL)
+ *  @param   n      Input: Number of data points
+ *  @param   xp     Input: Coordinates of requested values
+ *  @param   out    Output: Interpolated values
+ *  @param   np     Input: Number of requested values
+ *  @param   eq     Input: If non-zero: table is at equidistant points.
+ *  @param   clip   Input: Zero: extrapolate with edge value, non-zero: 0. outside range.
+ *  @param   scheme Input: Interpolation scheme 0 to 4.
+ */
+
+static void rpol_1d_batch_acc (double *x, double *y, const CsplinePar *csp, int n, 
+   const RpolAccel *acc, const double *xp, double *out, size_t np, int eq, int clip, int scheme);
+
+void rpol_1d_batch (double *x, double *y, const CsplinePar *csp, int n, 
+   const double *xp, double *out, size_t np, int eq, int clip, int scheme)
+{
+   rpol_1d_batch_acc(x, y, csp, n, NULL, xp, out, np, eq, clip, scheme);
+}
+
+static void rpol_1d_batch_acc (double *x, double *y, const CsplinePar *csp, int n, 
+   const RpolAccel *acc, const double *xp, double *out, size_t np, int eq, int clip, int scheme)
+{
+   int ipl[RPOL_BATCH_CHUNK];
+   double rpl[RPOL_BATCH_CHUNK], xc[RPOL_BATCH_CHUNK];
+   size_t i, k, m;
+   double lo, hi, xlo, xhi;
+
+   if ( (scheme == 3 || scheme == 4) && (n < 4 || csp == NULL) )
+      scheme = 1; /* As in rpol_cspline() */
+
+   if ( n < 2 || x[1] <= x[0] || scheme < 0 || scheme > 4 ) /* Invalid table */
+   {
+      for ( i=0; i<np; i++ )
+         out[i] = 0.;
+      return;
+   }
+
+   if ( scheme == 2 )
+   {
+      for ( i=0; i<np; i++ )
+         out[i] = rpol_2nd_order(x, y, n, xp[i], eq, clip);
+      return;
+   }
+
+   xlo = x[0];
+   xhi = x[n-1];
+   lo = clip ? 0. : y[0];
+   hi = clip ? 0. : y[n-1];
+
+   for ( k=0; k<np; k+=RPOL_BATCH_CHUNK )
+   {
+      const double *xk = xp + k;
+      double *ok = out + k;
+      m = (np-k < RPOL_BATCH_CHUNK) ? np-k : RPOL_BATCH_CHUNK;
+
+      for ( i=0; i<m; i++ )
+         xc[i] = (xk[i] < xlo) ? xlo : ((xk[i] > xhi) ? xhi : xk[i]);
+      locate_batch(x, n, acc, xc, m, eq, ipl, rpl);
+
+      switch ( scheme )
+      {
+         case 0:
+            for ( i=0; i<m; i++ )
+               ok[i] = (rpl[i] < 0.5) ? y[ipl[i]-1] : y[ipl[i]];
+            break;
+         case 1:
+            for ( i=0; i<m; i++ )
+               ok[i] = y[ipl[i]-1]*(1.-rpl[i]) + y[ipl[i]]*rpl[i];
+            break;
+         case 3:
+         case 4:
+            for ( i=0; i<m; i++ )
+               ok[i] = csx(xc[i] - x[ipl[i]-1], csp+ipl[i]-1);
+            break;
+      }
+
+      for ( i=0; i<m; i++ )
+         ok[i] = (xk[i] < xlo) ? lo : ((xk[i] > xhi) ? hi : ok[i]);
+   }
+}
+
+/* ----------------------------- rpol_2d_linear_batch ------------------------------- */
+/**
+ *  @short Linear interpolation in 2-D for many coordinate pairs at once,
+ *         with the same results as rpol_2d_linear() for each pair.
+ */
+
+static void rpol_2d_linear_batch_acc (double *x, double *y, double *z, int nx, int ny, 
+   const RpolAccel *xacc, const RpolAccel *yacc,
+   const double *xp, const double *yp, double *out, size_t np, int eq, int clip);
+
+void rpol_2d_linear_batch (double *x, double *y, double *z, int nx, int ny, 
+   const double *xp, const double *yp, double *out, size_t np, int eq, int clip)
+{
+   rpol_2d_linear_batch_acc(x, y, z, nx, ny, NULL, NULL, xp, yp, out, np, eq, clip);
+}
+
+static void rpol_2d_linear_batch_acc (double *x, double *y, double *z, int nx, int ny, 
+   const RpolAccel *xacc, const RpolAccel *yacc,
+   const double *xp, const double *yp, double *out, size_t np, int eq, int clip)
+{
+   int ipl[RPOL_BATCH_CHUNK], jpl[RPOL_BATCH_CHUNK];
+   double rpl[RPOL_BATCH_CHUNK], spl[RPOL_BATCH_CHUNK];
+   double xc[RPOL_BATCH_CHUNK], yc[RPOL_BATCH_CHUNK];
+   size_t i, k, m;
+   double xlo, xhi, ylo, yhi;
+
+   if ( nx < 2 || ny < 2 || x[1] <= x[0] || y[1] <= y[0] ) /* Invalid table */
+   {
+      for ( i=0; i<np; i++ )
+         out[i] = 0.;
+      return;
+   }
+
+   xlo = x[0];
+   xhi = x[nx-1];
+   ylo = y[0];
+   yhi = y[ny-1];
+
+   for ( k=0; k<np; k+=RPOL_BATCH_CHUNK )
+   {
+      const double *xk = xp + k, *yk = yp + k;
+      double *ok = out + k;
+      m = (np-k < RPOL_BATCH_CHUNK) ? np-k : RPOL_BATCH_CHUNK;
+
+      for ( i=0; i<m; i++ )
+      {
+         xc[i] = (xk[i] < xlo) ? xlo : ((xk[i] > xhi) ? xhi : xk[i]);
+         yc[i] = (yk[i] < ylo) ? ylo : ((yk[i] > yhi) ? yhi : yk[i]);
+      }
+      locate_batch(x, nx, xacc, xc, m, (eq&1), ipl, rpl);
+      locate_batch(y, ny, yacc, yc, m, (eq&2), jpl, spl);
+
+      for ( i=0; i<m; i++ )
+      {
+         /* Outside the range the edge value is used: rpl/spl exactly 0 or 1 */
+         double r = (xk[i] > xhi) ? 1. : rpl[i];
+         double s = (yk[i] > yhi) ? 1. : spl[i];
+         const double *z0 = z + (ipl[i]-1)*ny + (jpl[i]-1);
+         double v = ( z0[0]*(1.-r) + z0[ny]*r ) * (1.-s)
+                  + ( z0[1]*(1.-r) + z0[ny+1]*r ) * s;
+         int outside = (xk[i] < xlo || xk[i] > xhi || yk[i] < ylo || yk[i] > yhi);
+         ok[i] = (clip && outside) ? 0. : v;
+      }
+   }
+}
+
+/* ----------------------------- rpolate_1d_batch ------------------------------- */
+/**
+ *  @short Batch version of rpolate_1d(), for n x values at once.
+ *
+ *  The table, scheme and log options are resolved once for all values.
+ *  Results are as from rpolate_1d() for each value (see rpol_1d_batch()).
+ *
+ *  @param rpt    Pointer to interpolation table structure (1-D, or 2-D for scheme -1/-2).
+ *  @param x      The x coordinate values.
+ *  @param out    The interpolated values.
+ *  @param n      The number of values.
+ *  @param scheme Interpolation scheme as for rpolate_1d().
+ */
+
+void rpolate_1d_batch(struct rpol_table *rpt, const double *x, double *out, size_t n, int scheme)
+{
+   double xt[RPOL_BATCH_CHUNK];
+   double *ztab;
+   const CsplinePar *csp = NULL;
+   size_t i, k, m;
+
+   if ( rpt == NULL )
+   {
+      for ( i=0; i<n; i++ )
+         out[i] = 0.;
+      return;
+   }
+
+   if ( scheme < 0 && scheme >= -2 && rpt->ndim >= 2 && 
+        (scheme == -1 ? rpt->zxmax : rpt->zxmin) != NULL )
+   {
+      /* Upper or lower envelope projection from a 2-D table, always linear */
+      ztab = (scheme == -1) ? rpt->zxmax : rpt->zxmin;
+      scheme = 1;
+   }
+   else
+   {
+      if ( scheme < 0 && rpt->ndim >= 2 )
+         fprintf(stderr,"Unexpected scheme %d interpolation in ndim=%d table %s (zxmin %s NULL, zxmax %s NULL).\n",
+            scheme, rpt->ndim, rpt->fname, (rpt->zxmin == NULL)?"is":"is not", (rpt->zxmax == NULL)?"is":"is not");
+      if ( rpt->ndim != 1 )
+      {
+         fprintf(stderr,"Requested 1-D interpolation (scheme %d) from non-1-D table %s.\n", scheme, rpt->fname);
+         for ( i=0; i<n; i++ )
+            out[i] = 0.;
+         return;
+      }
+      if ( scheme < 0 || scheme > 4 )
+         scheme = rpt->scheme;
+      ztab = rpt->z;
+      if ( scheme == 3 || scheme == 4 )
+         csp = rpol_get_csp(rpt, scheme);
+   }
+
+   for ( k=0; k<n; k+=RPOL_BATCH_CHUNK )
+   {
+      const double *xk = x + k;
+      double *ok = out + k;
+      m = (n-k < RPOL_BATCH_CHUNK) ? n-k : RPOL_BATCH_CHUNK;
+
+      if ( rpt->xlog )
+      {
+         for ( i=0; i<m; i++ )
+            xt[i] = (xk[i] > 0.) ? log(xk[i]) : 0.;
+         xk = xt;
+      }
+      rpol_1d_batch_acc(rpt->x, ztab, csp, (int) rpt->nx, rpt->xacc, xk, ok, m,
+         (rpt->equidistant & 0x01), rpt->clipping, scheme);
+      if ( rpt->zlog )
+      {
+         for ( i=0; i<m; i++ )
+            ok[i] = exp(ok[i]);
+      }
+      if ( rpt->xlog )
+      {
+         for ( i=0; i<m; i++ )
+            if ( !(x[k+i] > 0.) )
+               ok[i] = 0.;
+      }
+   }
+}
+
+/* ----------------------------- rpolate_2d_batch ------------------------------- */
+/**
+ *  @short Batch version of rpolate_2d(), for n (x,y) pairs at once.
+ *     Falls back to rpolate_1d_batch() for 1-D tables, after a warning.
+ */
+
+void rpolate_2d_batch(struct rpol_table *rpt, const double *x, const double *y, 
+   double *out, size_t n, int scheme)
+{
+   double xt[RPOL_BATCH_CHUNK], yt[RPOL_BATCH_CHUNK];
+   size_t i, k, m;
+   int xlog, ylog;
+
+   if ( rpt == NULL )
+   {
+      for ( i=0; i<n; i++ )
+         out[i] = 0.;
+      return;
+   }
+
+   if ( rpt->ndim != 2 && rpt->ndim != 3 )
+   {
+      fprintf(stderr,"Requested 2-D interpolation from non-2-D table %s (fall-back to 1-D).\n", rpt->fname);
+      rpolate_1d_batch(rpt,x,out,n,scheme);
+      return;
+   }
+
+   if ( scheme < 0 || scheme > 4 )
+      scheme = rpt->scheme;
+   if ( scheme < 0 || scheme > 4 )
+   {
+      if ( rpol_verbosity > 0 )
+         fprintf(stderr,"Interpolation table '%s' is not usable.\n", rpt->fname);
+      for ( i=0; i<n; i++ )
+         out[i] = 0.;
+      return;
+   }
+
+   xlog = (rpt->logs && rpt->xlog);
+   ylog = (rpt->logs && rpt->ylog);
+
+   for ( k=0; k<n; k+=RPOL_BATCH_CHUNK )
+   {
+      const double *xk = x + k, *yk = y + k;
+      double *ok = out + k;
+      m = (n-k < RPOL_BATCH_CHUNK) ? n-k : RPOL_BATCH_CHUNK;
+
+      if ( xlog )
+      {
+         for ( i=0; i<m; i++ )
+            xt[i] = (xk[i] > 0.) ? log(xk[i]) : 0.;
+         xk = xt;
+      }
+      if ( ylog )
+      {
+         for ( i=0; i<m; i++ )
+            yt[i] = (yk[i] > 0.) ? log(yk[i]) : 0.;
+         yk = yt;
+      }
+      /* In 2-D tables it is always linear interpolation. */
+      rpol_2d_linear_batch_acc(rpt->x, rpt->y, rpt->z, (int) rpt->nx, (int) rpt->ny, 
+         rpt->xacc, rpt->yacc, xk, yk, ok, m, rpt->equidistant, rpt->clipping);
+      if ( rpt->zlog )
+      {
+         for ( i=0; i<m; i++ )
+            ok[i] = exp(ok[i]);
+      }
+      if ( xlog || ylog )
+      {
+         for ( i=0; i<m; i++ )
+            if ( (xlog && !(x[k+i] > 0.)) || (ylog && !(y[k+i] > 0.)) )
+               ok[i] = 0.;
+      }
+   }
+}
+
+/* ==================== Single-precision compact tables ========================= */
+
+/*
+   A compact copy of a table in single precision, for use where large
+   tables are interpolated per photon and the double arrays would not
+   stay in cache. Compact tables are always interpolated linearly
+   (bilinear in 2-D), with the clipping and log options of the source
+   table. For 1-D tables the values can be stored interleaved with the
+   slope to the next supporting point, so that each lookup touches a
+   single pair of floats. The upper/lower envelopes of 2-D tables are
+   not copied. Compact tables are not shared and not cached; the source
+   table can be freed once the compact copy is made.
+*/
+
+/* --------------------------- locate_batch_f ------------------------------- */
+/**
+ *  @short Single-precision counterpart of locate_batch(), with the
+ *     lower index of the interval (0 ... n-2) and the fraction within it.
+ *     For non-equidistant points the fraction is replaced by the distance
+ *     to the lower point if 'dist' is non-zero.
+ */
+
+static inline int accel_ipl_f (const RpolAccel *acc, const float *v, float xp)
+{
+   size_t b = accel_bucket(acc,xp);
+   int j = acc->first[b], len = acc->first[b+1] - j;
+   while ( len > 0 )
+   {
+      int half = len / 2;
+      if ( v[j+half] < xp )
+      {
+         j += half + 1;
+         len -= half + 1;
+      }
+      else
+         len = half;
+   }
+   return j;
+}
+
+static void locate_batch_f (const float *v, int n, const RpolAccel *acc, float v0, float dvi,
+   const float *xp, size_t np, int *ipl, float *rpl, int dist)
+{
+   size_t i;
+
+   if ( v == NULL ) /* Equidistant */
+   {
+      for ( i=0; i<np; i++ )
+      {
+         float u = (xp[i]-v0)*dvi;
+         int j = (int) u;
+         j = (j > n-2) ? n-2 : j;
+         ipl[i] = j;
+         rpl[i] = u - (float) j;
+      }
+      return;
+   }
+
+   if ( acc != NULL )
+   {
+      for ( i=0; i<np; i++ )
+         ipl[i] = accel_ipl_f(acc, v, xp[i]) - 1;
+   }
+   else
+   {
+      for ( i=0; i<np; i++ )
+      {
+         const float *base = v;
+         int len = n, j;
+         while ( len > 1 )
+         {
+            int half = len / 2;
+            base = (base[half] < xp[i]) ? base + half : base;
+            len -= half;
+         }
+         j = (int) (base - v);
+         ipl[i] = (j > n-2) ? n-2 : j;
+      }
+   }
+   for ( i=0; i<np; i++ )
+   {
+      int j = ipl[i];
+      if ( dist )
+         rpl[i] = xp[i] - v[j];
+      else
+         rpl[i] = (v[j+1] != v[j]) ? (xp[i]-v[j])/(v[j+1]-v[j]) : 0.5f;
+   }
+}
+
+/* Bucket index over single-precision supporting points (NULL if too few or not strictly ascending) */
+
+static RpolAccel *rpol_build_accel_f (const float *v, size_t n)
+{
+   RpolAccel *acc;
+   double *vd;
+   size_t i;
+
+   if ( v == NULL || n < rpol_accel_min || rpol_accel_min == 0 )
+      return NULL;
+   if ( (vd = (double *) malloc(n*sizeof(double))) == NULL )
+      return NULL;
+   for ( i=0; i<n; i++ )
+      vd[i] = v[i];
+   acc = rpol_build_accel(vd, n);
+   free(vd);
+   return acc;
+}
+
+/* ------------------------------ rpol_compact ------------------------------- */
+/**
+ *  @short Make a single-precision compact copy of an interpolation table.
+ *
+ *  @param rpt        The source table (1-D or 2-D, ascending supporting points).
+ *  @param interleave For 1-D tables: non-zero to store (z, slope) pairs.
+ *
+ *  @return Pointer to the new table, to be freed with rpol_free_compact(),
+ *          or NULL if the table is not usable.
+ */
+
+struct rpol_ftable *rpol_compact (const struct rpol_table *rpt, int interleave);
+
+struct rpol_ftable *rpol_compact (const struct rpol_table *rpt, int interleave)
+{
+   struct rpol_ftable *ft;
+   size_t i, nz;
+
+   if ( rpt == NULL || rpt->x == NULL || rpt->z == NULL )
+      return NULL;
+   if ( rpt->nx < 2 || rpt->x[1] <= rpt->x[0] || rpt->xrise != 1 )
+   {
+      fprintf(stderr,"Table %s not usable for a compact copy.\n", rpt->fname ? rpt->fname : "(unnamed)");
+      return NULL;
+   }
+   if ( rpt->ndim != 1 && (rpt->y == NULL || rpt->ny < 2 || rpt->y[1] <= rpt->y[0] || rpt->yrise != 1) )
+   {
+      fprintf(stderr,"Table %s not usable for a compact copy.\n", rpt->fname ? rpt->fname : "(unnamed)");
+      return NULL;
+   }
+   if ( rpt->nx > INT_MAX || rpt->ny > INT_MAX )
+      return NULL;
+
+   if ( (ft = (struct rpol_ftable *) calloc(1,sizeof(struct rpol_ftable))) == NULL )
+      return NULL;
+   ft->ndim = (rpt->ndim == 1) ? 1 : 2;
+   ft->nx = (int) rpt->nx;
+   ft->ny = (ft->ndim == 1) ? 0 : (int) rpt->ny;
+   ft->equidistant = rpt->equidistant & ((ft->ndim == 1) ? 1 : 3);
+   ft->clipping = rpt->clipping;
+   ft->xlog = (rpt->logs && rpt->xlog);
+   ft->ylog = (rpt->logs && rpt->ylog && ft->ndim == 2);
+   ft->zlog = rpt->zlog;
+   ft->interleaved = (interleave && ft->ndim == 1);
+   ft->xmin = (float) rpt->x[0];
+   ft->xmax = (float) rpt->x[rpt->nx-1];
+   ft->dxi = (float) (1./(rpt->x[1] - rpt->x[0]));
+   if ( ft->ndim == 2 )
+   {
+      ft->ymin = (float) rpt->y[0];
+      ft->ymax = (float) rpt->y[rpt->ny-1];
+      ft->dyi = (float) (1./(rpt->y[1] - rpt->y[0]));
+   }
+
+   if ( !(ft->equidistant & 1) )
+   {
+      if ( (ft->x = (float *) malloc(rpt->nx*sizeof(float))) == NULL )
+      {
+         rpol_free_compact(ft);
+         return NULL;
+      }
+      for ( i=0; i<rpt->nx; i++ )
+         ft->x[i] = (float) rpt->x[i];
+   ft->xacc = rpol_build_accel_f(ft->x, rpt->nx);
+   }
+   if ( ft->ndim == 2 && !(ft->equidistant & 2) )
+   {
+      if ( (ft->y = (float *) malloc(rpt->ny*sizeof(float))) == NULL )
+      {
+         rpol_free_compact(ft);
+         return NULL;
+      }
+      for ( i=0; i<rpt->ny; i++ )
+         ft->y[i] = (float) rpt->y[i];
+   ft->yacc = rpol_build_accel_f(ft->y, rpt->ny);
+   }
+
+   if ( ft->interleaved )
+   {
+      if ( (ft->zs = (float *) malloc(2*rpt->nx*sizeof(float))) == NULL )
+      {
+         rpol_free_compact(ft);
+         return NULL;
+      }
+      for ( i=0; i+1<rpt->nx; i++ )
+      {
+         double dz = rpt->z[i+1] - rpt->z[i];
+         ft->zs[2*i] = (float) rpt->z[i];
+         /* Slope per step for equidistant x, per unit of x otherwise */
+         if ( (ft->equidistant & 1) )
+            ft->zs[2*i+1] = (float) dz;
+         else
+            ft->zs[2*i+1] = (rpt->x[i+1] > rpt->x[i]) ? (float) (dz/(rpt->x[i+1]-rpt->x[i])) : 0.f;
+      }
+      ft->zs[2*i] = (float) rpt->z[i];
+      ft->zs[2*i+1] = 0.f;
+   }
+   else
+   {
+      nz = (ft->ndim == 1) ? rpt->nx : rpt->nx*rpt->ny;
+      if ( (ft->z = (float *) malloc(nz*sizeof(float))) == NULL )
+      {
+         rpol_free_compact(ft);
+         return NULL;
+      }
+      for ( i=0; i<nz; i++ )
+         ft->z[i] = (float) rpt->z[i];
+   }
+
+   return ft;
+}
+
+/* --------------------------- rpol_free_compact ----------------------------- */
+/**
+ *  @short Free a table obtained from rpol_compact().
+ */
+
+void rpol_free_compact (struct rpol_ftable *ft);
+
+void rpol_free_compact (struct rpol_ftable *ft)
+{
+   if ( ft == NULL )
+      return;
+   free(ft->x);
+   free(ft->y);
+   free(ft->z);
+   free(ft->zs);
+   rpol_free_accel(ft->xacc);
+   rpol_free_accel(ft->yacc);
+   free(ft);
+}
+
+/* --------------------------- rpolate_1d_f_batch ----------------------------- */
+/**
+ *  @short Linear interpolation in a compact 1-D table for n values at once.
+ *
+ *  @param ft   Compact table from rpol_compact().
+ *  @param x    The x coordinate values.
+ *  @param out  The interpolated values.
+ *  @param n    The number of values.
+ */
+
+void rpolate_1d_f_batch (const struct rpol_ftable *ft, const float *x, float *out, size_t n);
+
+void rpolate_1d_f_batch (const struct rpol_ftable *ft, const float *x, float *out, size_t n)
+{
+   int ipl[RPOL_BATCH_CHUNK];
+   float rpl[RPOL_BATCH_CHUNK], xc[RPOL_BATCH_CHUNK];
+   size_t i, k, m;
+   float lo, hi, xlo, xhi;
+   int nx;
+
+   if ( ft == NULL || ft->ndim != 1 )
+   {
+      if ( ft != NULL )
+         fprintf(stderr,"Requested 1-D interpolation from non-1-D compact table.\n");
+      for ( i=0; i<n; i++ )
+         out[i] = 0.f;
+      return;
+   }
+
+   nx = ft->nx;
+   xlo = ft->xmin;
+   xhi = ft->xmax;
+   if ( ft->interleaved )
+   {
+      lo = ft->zs[0];
+      hi = ft->zs[2*(nx-1)];
+   }
+   else
+   {
+      lo = ft->z[0];
+      hi = ft->z[nx-1];
+   }
+   if ( ft->zlog )
+   {
+      lo = expf(lo);
+      hi = expf(hi);
+   }
+   if ( ft->clipping )
+      lo = hi = 0.f;
+
+   for ( k=0; k<n; k+=RPOL_BATCH_CHUNK )
+   {
+      const float *xk = x + k;
+      float *ok = out + k;
+      m = (n-k < RPOL_BATCH_CHUNK) ? n-k : RPOL_BATCH_CHUNK;
+
+      for ( i=0; i<m; i++ )
+      {
+         float xv = xk[i];
+         if ( ft->xlog )
+            xv = (xv > 0.f) ? logf(xv) : xlo;
+         xc[i] = (xv < xlo) ? xlo : ((xv > xhi) ? xhi : xv);
+      }
+      locate_batch_f(ft->x, nx, ft->xacc, xlo, ft->dxi, xc, m, ipl, rpl, ft->interleaved);
+
+      if ( ft->interleaved )
+      {
+         const float *zs = ft->zs;
+         for ( i=0; i<m; i++ )
+            ok[i] = zs[2*ipl[i]] + rpl[i]*zs[2*ipl[i]+1];
+      }
+      else
+      {
+         const float *z = ft->z;
+         for ( i=0; i<m; i++ )
+            ok[i] = z[ipl[i]] + rpl[i]*(z[ipl[i]+1] - z[ipl[i]]);
+      }
+      if ( ft->zlog )
+      {
+         for ( i=0; i<m; i++ )
+            ok[i] = expf(ok[i]);
+      }
+
+      for ( i=0; i<m; i++ )
+      {
+         float xv = xk[i];
+         if ( ft->xlog )
+         {
+            if ( !(xv > 0.f) )
+            {
+               ok[i] = 0.f;
+               continue;
+            }
+            xv = logf(xv);
+         }
+         ok[i] = (xv < xlo) ? lo : ((xv > xhi) ? hi : ok[i]);
+      }
+   }
+}
+
+/* --------------------------- rpolate_2d_f_batch ----------------------------- */
+/**
+ *  @short Bilinear interpolation in a compact 2-D table for n (x,y) pairs at once.
+ */
+
+void rpolate_2d_f_batch (const struct rpol_ftable *ft, const float *x, const float *y, float *out, size_t n);
+
+void rpolate_2d_f_batch (const struct rpol_ftable *ft, const float *x, const float *y, float *out, size_t n)
+{
+   int ipl[RPOL_BATCH_CHUNK], jpl[RPOL_BATCH_CHUNK];
+   float rpl[RPOL_BATCH_CHUNK], spl[RPOL_BATCH_CHUNK];
+   float xc[RPOL_BATCH_CHUNK], yc[RPOL_BATCH_CHUNK];
+   char zero[RPOL_BATCH_CHUNK];
+   size_t i, k, m;
+   int nx, ny;
+
+   if ( ft == NULL || ft->ndim != 2 )
+   {
+      if ( ft != NULL )
+         rpolate_1d_f_batch(ft, x, out, n);
+      else
+      {
+         for ( i=0; i<n; i++ )
+            out[i] = 0.f;
+      }
+      return;
+   }
+
+   nx = ft->nx;
+   ny = ft->ny;
+
+   for ( k=0; k<n; k+=RPOL_BATCH_CHUNK )
+   {
+      const float *xk = x + k, *yk = y + k;
+      float *ok = out + k;
+      m = (n-k < RPOL_BATCH_CHUNK) ? n-k : RPOL_BATCH_CHUNK;
+
+      for ( i=0; i<m; i++ )
+      {
+         float xv = xk[i], yv = yk[i];
+         if ( ft->xlog )
+            xv = (xv > 0.f) ? logf(xv) : ft->xmin;
+         if ( ft->ylog )
+            yv = (yv > 0.f) ? logf(yv) : ft->ymin;
+         xc[i] = (xv < ft->xmin) ? ft->xmin : ((xv > ft->xmax) ? ft->xmax : xv);
+         yc[i] = (yv < ft->ymin) ? ft->ymin : ((yv > ft->ymax) ? ft->ymax : yv);
+         /* Outside the range the edge value is used, as in rpol_2d_linear(), or zero with clipping */
+         zero[i] = (ft->xlog && !(xk[i] > 0.f)) || (ft->ylog && !(yk[i] > 0.f)) ||
+            (ft->clipping && (xv < ft->xmin || xv > ft->xmax || yv < ft->ymin || yv > ft->ymax));
+      }
+      locate_batch_f(ft->x, nx, ft->xacc, ft->xmin, ft->dxi, xc, m, ipl, rpl, 0);
+      locate_batch_f(ft->y, ny, ft->yacc, ft->ymin, ft->dyi, yc, m, jpl, spl, 0);
+
+      for ( i=0; i<m; i++ )
+      {
+         const float *z0 = ft->z + ipl[i]*ny + jpl[i];
+         float r = rpl[i], s = spl[i];
+         float v = ( z0[0]*(1.f-r) + z0[ny]*r ) * (1.f-s)
+                 + ( z0[1]*(1.f-r) + z0[ny+1]*r ) * s;
+         if ( ft->zlog )
+            v = expf(v);
+         ok[i] = zero[i] ? 0.f : v;
+      }
+   }
+}
+
+/* ------------------------------ rpolate_f -------------------------------- */
+/**
+ *  @short Interpolation of a single value in a compact 1-D or 2-D table
+ *     (y is ignored for 1-D tables).
+ */
+
+double rpolate_f (const struct rpol_ftable *ft, double x, double y);
+
+double rpolate_f (const struct rpol_ftable *ft, double x, double y)
+{
+   float xf = (float) x, yf = (float) y, r, s, z;
+   int i, j;
+
+   if ( ft == NULL )
+      return 0.;
+   if ( ft->xlog )
+   {
+      if ( !(xf > 0.f) )
+         return 0.;
+      xf = logf(xf);
+   }
+   if ( ft->ndim == 1 )
+   {
+      if ( xf < ft->xmin || xf > ft->xmax )
+      {
+         if ( ft->clipping )
+            return 0.;
+         i = (xf < ft->xmin) ? 0 : ft->nx-1;
+         z = ft->interleaved ? ft->zs[2*i] : ft->z[i];
+      }
+      else
+      {
+         locate_batch_f(ft->x, ft->nx, ft->xacc, ft->xmin, ft->dxi, &xf, 1, &i, &r, ft->interleaved);
+         if ( ft->interleaved )
+            z = ft->zs[2*i] + r*ft->zs[2*i+1];
+         else
+            z = ft->z[i] + r*(ft->z[i+1] - ft->z[i]);
+      }
+   }
+   else
+   {
+      const float *z0;
+      if ( ft->ylog )
+      {
+         if ( !(yf > 0.f) )
+            return 0.;
+         yf = logf(yf);
+      }
+      if ( ft->clipping && (xf < ft->xmin || xf > ft->xmax || yf < ft->ymin || yf > ft->ymax) )
+         return 0.;
+      xf = (xf < ft->xmin) ? ft->xmin : ((xf > ft->xmax) ? ft->xmax : xf);
+      yf = (yf < ft->ymin) ? ft->ymin : ((yf > ft->ymax) ? ft->ymax : yf);
+      locate_batch_f(ft->x, ft->nx, ft->xacc, ft->xmin, ft->dxi, &xf, 1, &i, &r, 0);
+      locate_batch_f(ft->y, ft->ny, ft->yacc, ft->ymin, ft->dyi, &yf, 1, &j, &s, 0);
+      z0 = ft->z + i*ft->ny + j;
+      z = ( z0[0]*(1.f-r) + z0[ft->ny]*r ) * (1.f-s)
+        + ( z0[1]*(1.f-r) + z0[ft->ny+1]*r ) * s;
+   }
+
+   return ft->zlog ? exp(z) : z;
+}
+
 #ifdef TEST
 
 /* ==================== Test code ========================= */
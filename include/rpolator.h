@@ -48,7 +48,21 @@ struct cubic_params
 };
 typedef struct cubic_params CsplinePar;
 
-/** Structure describing an interpolation table, interpolation scheme and selected options. */
+/** Bucket index for O(1) interval search in non-equidistant supporting points. */
+
+struct rpol_accel
+{
+   size_t nb;         /**< Number of buckets of equal width over the full range */
+   double x0, dxi;    /**< Start of the first bucket and inverse bucket width */
+   int *first;        /**< Interval index (1 ... n-1) for the lower end of each bucket (nb+1 entries) */
+};
+typedef struct rpol_accel RpolAccel;
+
+/** Structure describing an interpolation table, interpolation scheme and selected options.
+ *  Tables are read-only once read_rpol_table() (or rpol_check_equi_range() after
+ *  remapping) has returned and may then be used from several threads at once;
+ *  the interpolation functions only read them. Each thread holding a table
+ *  should count as a user (rpol_share) and release it with rpol_free(). */
 
 struct rpol_table
 {
@@ -79,10 +93,37 @@ struct rpol_table
    int zxreq;         /**< Flag activated when options indicate that a set of zxmax values should be provided. */
    int logs, xlog, ylog, zlog; /**< Log applied to any x/y axis, to x axis, y axis, z axis? */
    CsplinePar *csp;   /**< Cubic spline parameters (scheme 3 and 4 only), need one-time initialisation. */
-   int use_count;     /**< Indicates how often a table is in use, but not safe enough to make it a smart pointer. */
+   CsplinePar *csp_type[2]; /**< Natural [0] and clamped [1] splines set up on first use by other schemes. */
+   int csp_once[2];   /**< Set once the set-up of csp_type[i] was done (or tried), never repeated. */
+   int use_count;     /**< Indicates how often a table is in use (changed atomically, see rpol_share). */
+   RpolAccel *xacc;   /**< Optional bucket index for non-equidistant x (set up by rpol_check_equi_range) */
+   RpolAccel *yacc;   /**< Optional bucket index for non-equidistant y (2-D) */
+   void *cache_map;   /**< Mapped cache file (see RPOL_CACHE) if the arrays are used from there */
+   size_t cache_len;  /**< Length of the mapped cache file */
 };
 typedef struct rpol_table RpolTable;
 
+/** Single-precision compact copy of a table (see rpol_compact), always interpolated linearly. */
+
+struct rpol_ftable
+{
+   int ndim;          /**< 1 or 2 dimension(s) */
+   int nx, ny;        /**< No. of entries in x and y (2-D only) */
+   int equidistant;   /**< Bit 0: x, bit 1: y equidistant (no supporting points stored then) */
+   int clipping;      /**< 0: Extrapolate with edge value, 1: zero outside range. */
+   int xlog, ylog, zlog; /**< Log applied to x axis, y axis, z axis */
+   int interleaved;   /**< 1-D only: values stored in zs rather than z */
+   float xmin, xmax, dxi; /**< Range in x and inverse step size (equidistant only) */
+   float ymin, ymax, dyi; /**< Range in y and inverse step size (2-D, equidistant only) */
+   float *x;          /**< Supporting points in x (NULL if equidistant) */
+   float *y;          /**< Supporting points in y (NULL if equidistant or 1-D) */
+   float *z;          /**< Table values (nx or nx*ny), NULL if interleaved */
+   float *zs;         /**< Pairs of z[i] and slope to z[i+1] (per step if equidistant, else per unit of x) */
+   RpolAccel *xacc;   /**< Optional bucket index for non-equidistant x */
+   RpolAccel *yacc;   /**< Optional bucket index for non-equidistant y (2-D) */
+};
+typedef struct rpol_ftable RpolFTable;
+
 /* rpolator.c */
 int read_table(const char *fname, int maxrow, double *col1, double *col2);
 int read_table2(const char *fname, int maxrow, double *col1, double *col2);
@@ -105,7 +146,11 @@ int rpol_set_verbose(int lvl);
 void rpol_info(struct rpol_table *rpt);
 void rpol_info_lvl (struct rpol_table *rpt, int lvl);
 void rpol_free(struct rpol_table *rpt, int removing);
+struct rpol_table *rpol_share(struct rpol_table *rpt);
 void rpol_check_equi_range(struct rpol_table *rpt);
+size_t rpol_set_accel_min(size_t n);
+RpolAccel *rpol_build_accel (const double *v, size_t n);
+void rpol_free_accel (RpolAccel *acc);
 
 double rpol(double *x, double *y, int n, double xp);
 double rpol_nearest(double *x, double *y, int n, double xp, int eq, int clip);
@@ -120,6 +165,20 @@ double rpolate_1d_lin(struct rpol_table *rpt, double x);
 double rpolate_2d(struct rpol_table *rpt, double x, double y, int scheme);
 double rpolate(struct rpol_table *rpt, double x, double y, int scheme);
 
+void rpol_1d_batch (double *x, double *y, const CsplinePar *csp, int n, 
+   const double *xp, double *out, size_t np, int eq, int clip, int scheme);
+void rpol_2d_linear_batch (double *x, double *y, double *z, int nx, int ny, 
+   const double *xp, const double *yp, double *out, size_t np, int eq, int clip);
+void rpolate_1d_batch(struct rpol_table *rpt, const double *x, double *out, size_t n, int scheme);
+void rpolate_2d_batch(struct rpol_table *rpt, const double *x, const double *y, 
+   double *out, size_t n, int scheme);
+
+struct rpol_ftable *rpol_compact (const struct rpol_table *rpt, int interleave);
+void rpol_free_compact (struct rpol_ftable *ft);
+void rpolate_1d_f_batch (const struct rpol_ftable *ft, const float *x, float *out, size_t n);
+void rpolate_2d_f_batch (const struct rpol_ftable *ft, const float *x, const float *y, float *out, size_t n);
+double rpolate_f (const struct rpol_ftable *ft, double x, double y);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,197 @@
+#include "Atm_table.h"
+#include "mc_atmprof.h"
+#include "atmprof.h"
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+Atm_table::Atm_table()
+{
+    clear();
+}
+
+Atm_table::~Atm_table()
+{
+
+}
+
+void Atm_table::clear()
+{
+    source = 0;
+    hmin = hmax = dh = dhi = 0.;
+    nh = nt = 0;
+    ltmin = ltmax = dlt = dlti = 0.;
+    rho.clear();
+    thick.clear();
+    refm1.clear();
+    height.clear();
+    std::fill(max_rel_err, max_rel_err + 4, 0.);
+}
+
+double Atm_table::ref_rho(double h) const
+{
+    return source ? rhofc(&h) : rhofx(h);
+}
+
+double Atm_table::ref_thick(double h) const
+{
+    return source ? thickc(&h) : thickx(h);
+}
+
+double Atm_table::ref_refm1(double h) const
+{
+    return source ? refim1c(&h) : refidx(h) - 1.;
+}
+
+double Atm_table::ref_height(double t) const
+{
+    return source ? heighc(&t) : heighx(t);
+}
+
+// Sample the reference functions. The profile (init_atmprof, init_atmprof_s or
+// atmegs_) must have been set up before. Returns 0 if ok, -1 otherwise.
+int Atm_table::build(int src, double h_low, double h_high, double step)
+{
+    clear();
+    if(step <= 0. || h_high <= h_low)
+        return -1;
+    source = src;
+    nh = (int) ceil((h_high - h_low) / step) + 1;
+    hmin = h_low;
+    dh = (h_high - h_low) / (nh - 1);
+    dhi = 1. / dh;
+    hmax = hmin + (nh - 1) * dh;
+    rho.resize(nh);
+    thick.resize(nh);
+    refm1.resize(nh);
+    for(int i = 0; i < nh; i++)
+    {
+        double h = hmin + i * dh;
+        rho[i] = ref_rho(h);
+        thick[i] = ref_thick(h);
+        refm1[i] = ref_refm1(h);
+    }
+
+    if(thick[nh - 1] <= 0. || thick[0] <= thick[nh - 1])
+    {
+        std::cout << "Atmospheric profile not usable up to " << hmax << " cm" << std::endl;
+        clear();
+        return -1;
+    }
+    nt = nh;
+    ltmin = log(thick[nh - 1]);
+    ltmax = log(thick[0]);
+    dlt = (ltmax - ltmin) / (nt - 1);
+    dlti = 1. / dlt;
+    height.resize(nt);
+    for(int i = 0; i < nt; i++)
+    {
+        height[i] = ref_height(exp(ltmin + i * dlt));
+    }
+    return 0;
+}
+
+// Largest relative deviation from the reference functions, half-way between the
+// supporting points where linear interpolation is worst.
+void Atm_table::validate()
+{
+    std::fill(max_rel_err, max_rel_err + 4, 0.);
+    for(int i = 0; i + 1 < nh; i++)
+    {
+        double h = hmin + (i + 0.5) * dh;
+        double r = ref_rho(h), t = ref_thick(h), n = ref_refm1(h);
+        if(r > 0.)
+            max_rel_err[0] = std::max(max_rel_err[0], fabs(rhof(h) / r - 1.));
+        if(t > 0.)
+            max_rel_err[1] = std::max(max_rel_err[1], fabs(thickf(h) / t - 1.));
+        if(n > 0.)
+            max_rel_err[2] = std::max(max_rel_err[2], fabs((refidf(h) - 1.) / n - 1.));
+    }
+    for(int i = 0; i + 1 < nt; i++)
+    {
+        double t = exp(ltmin + (i + 0.5) * dlt);
+        double h = ref_height(t);
+        if(h > 0.)
+            max_rel_err[3] = std::max(max_rel_err[3], fabs(heighf(t) / h - 1.));
+    }
+}
+
+// linear interpolation in an equidistant table, clamped to its range
+static inline double interp_equi(const double* tab, int n, double x0, double dxi, double x)
+{
+    double u = (x - x0) * dxi;
+    u = std::min(std::max(u, 0.), (double) (n - 1));
+    int i = std::min((int) u, n - 2);
+    double f = u - i;
+    return tab[i] + f * (tab[i + 1] - tab[i]);
+}
+
+double Atm_table::rhof(double h) const
+{
+    if(!(h >= hmin && h <= hmax))
+        return ref_rho(h);
+    return interp_equi(rho.data(), nh, hmin, dhi, h);
+}
+
+double Atm_table::thickf(double h) const
+{
+    if(!(h >= hmin && h <= hmax))
+        return ref_thick(h);
+    return interp_equi(thick.data(), nh, hmin, dhi, h);
+}
+
+double Atm_table::refidf(double h) const
+{
+    if(!(h >= hmin && h <= hmax))
+        return 1. + ref_refm1(h);
+    return 1. + interp_equi(refm1.data(), nh, hmin, dhi, h);
+}
+
+double Atm_table::heighf(double t) const
+{
+    if(nt == 0 || !(t >= thick[nh - 1] && t <= thick[0]))
+        return ref_height(t);
+    return interp_equi(height.data(), nt, ltmin, dlti, log(t));
+}
+
+// Batch versions: one branch-free pass over all values, then the
+// few values outside the table are redone with the reference function.
+void Atm_table::rhof(const double* h, double* out, size_t n) const
+{
+    const double* tab = rho.data();
+    for(size_t i = 0; i < n; i++)
+        out[i] = interp_equi(tab, nh, hmin, dhi, h[i]);
+    for(size_t i = 0; i < n; i++)
+        if(!(h[i] >= hmin && h[i] <= hmax))
+            out[i] = ref_rho(h[i]);
+}
+
+void Atm_table::thickf(const double* h, double* out, size_t n) const
+{
+    const double* tab = thick.data();
+    for(size_t i = 0; i < n; i++)
+        out[i] = interp_equi(tab, nh, hmin, dhi, h[i]);
+    for(size_t i = 0; i < n; i++)
+        if(!(h[i] >= hmin && h[i] <= hmax))
+            out[i] = ref_thick(h[i]);
+}
+
+void Atm_table::refidf(const double* h, double* out, size_t n) const
+{
+    const double* tab = refm1.data();
+    for(size_t i = 0; i < n; i++)
+        out[i] = 1. + interp_equi(tab, nh, hmin, dhi, h[i]);
+    for(size_t i = 0; i < n; i++)
+        if(!(h[i] >= hmin && h[i] <= hmax))
+            out[i] = 1. + ref_refm1(h[i]);
+}
+
+void Atm_table::heighf(const double* t, double* out, size_t n) const
+{
+    const double* tab = height.data();
+    for(size_t i = 0; i < n; i++)
+        out[i] = (nt > 0) ? interp_equi(tab, nt, ltmin, dlti, log(t[i] > 0. ? t[i] : 1e-300)) : 0.;
+    for(size_t i = 0; i < n; i++)
+        if(nt == 0 || !(t[i] >= thick[nh - 1] && t[i] <= thick[0]))
+            out[i] = ref_height(t[i]);
+}
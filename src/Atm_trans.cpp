@@ -0,0 +1,248 @@
+#include "Atm_trans.h"
+#include "fileopen.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+Atm_trans::Atm_trans()
+{
+    clear();
+}
+
+Atm_trans::~Atm_trans()
+{
+
+}
+
+void Atm_trans::clear()
+{
+    obslev = 0.;
+    h_km.clear();
+    wl_nm.clear();
+    tau.clear();
+    nz = nwl = 0;
+    z0 = dzi = wl0 = dwli = 0.;
+    wl_min = 250.;
+    wl_max = 700.;
+    cache_airmass.clear();
+    cache_table.clear();
+    cache_next = 0;
+}
+
+// Returns 0 if ok, -1 on error
+int Atm_trans::read(const char* fname)
+{
+    FILE* f;
+    char line[10240];
+    int iline = 0;
+
+    clear();
+    if((f = fileopen(fname, "r")) == NULL)
+    {
+        perror(fname);
+        return -1;
+    }
+    while(fgets(line, sizeof(line) - 1, f) != NULL)
+    {
+        iline++;
+        char* s = line;
+        while(*s == ' ' || *s == '\t')
+            s++;
+        if(*s == '#')
+        {
+            char* h1 = strstr(s, "H1=");
+            char* h2 = strstr(s, "H2=");
+            if(h1 == NULL || h2 == NULL)
+                continue;
+            obslev = strtod(h2 + 3, NULL);
+            s = h1 + 3;
+            for(;;)
+            {
+                char* e;
+                double h = strtod(s, &e);
+                if(e == s)
+                    break;
+                h_km.push_back(h);
+                s = e;
+            }
+            continue;
+        }
+        if(*s == '\0' || *s == '\n')
+            continue;
+        if(h_km.empty())
+        {
+            std::cout << "No H1= line before data in " << fname << " line " << iline << std::endl;
+            fileclose(f);
+            clear();
+            return -1;
+        }
+        char* e;
+        double wl = strtod(s, &e);
+        if(e == s)
+            continue;
+        s = e;
+        for(size_t ih = 0; ih < h_km.size(); ih++)
+        {
+            double t = strtod(s, &e);
+            if(e == s)
+            {
+                std::cout << "Too few values in " << fname << " line " << iline << std::endl;
+                fileclose(f);
+                clear();
+                return -1;
+            }
+            tau.push_back(t);
+            s = e;
+        }
+        wl_nm.push_back(wl);
+    }
+    fileclose(f);
+    if(wl_nm.size() < 2 || h_km.size() < 1)
+    {
+        std::cout << "No usable extinction table in " << fname << std::endl;
+        clear();
+        return -1;
+    }
+
+    // 250 m steps from the observation level to the highest level, 5 nm steps
+    double dz = 25000.;
+    double dwl = 5.;
+    z0 = obslev * 1e5;
+    nz = std::max(2, (int) ceil((h_km.back() * 1e5 - z0) / dz) + 1);
+    dzi = 1. / dz;
+    wl0 = wl_nm.front();
+    nwl = std::max(2, (int) ceil((wl_nm.back() - wl0) / dwl) + 1);
+    dwli = 1. / dwl;
+    return 0;
+}
+
+// Vertical optical depth from height h [km] down to the observation level
+double Atm_trans::vertical_tau(double h, double lambda) const
+{
+    size_t nh = h_km.size();
+    if(h <= obslev)
+        return 0.;
+
+    size_t iw = std::upper_bound(wl_nm.begin(), wl_nm.end(), lambda) - wl_nm.begin();
+    iw = std::min(std::max(iw, (size_t) 1), wl_nm.size() - 1);
+    double fw = (lambda - wl_nm[iw - 1]) / (wl_nm[iw] - wl_nm[iw - 1]);
+    fw = std::min(std::max(fw, 0.), 1.);
+
+    double t_lo, t_hi, h_lo, h_hi;
+    size_t ih = std::upper_bound(h_km.begin(), h_km.end(), h) - h_km.begin();
+    if(ih == 0)
+    {
+        // between observation level and first level
+        h_lo = obslev;
+        h_hi = h_km[0];
+        t_lo = 0.;
+        t_hi = (1. - fw) * tau[(iw - 1) * nh] + fw * tau[iw * nh];
+    }
+    else if(ih >= nh)
+    {
+        return (1. - fw) * tau[(iw - 1) * nh + nh - 1] + fw * tau[iw * nh + nh - 1];
+    }
+    else
+    {
+        h_lo = h_km[ih - 1];
+        h_hi = h_km[ih];
+        t_lo = (1. - fw) * tau[(iw - 1) * nh + ih - 1] + fw * tau[iw * nh + ih - 1];
+        t_hi = (1. - fw) * tau[(iw - 1) * nh + ih] + fw * tau[iw * nh + ih];
+    }
+    if(h_hi <= h_lo)
+        return t_hi;
+    return t_lo + (h - h_lo) / (h_hi - h_lo) * (t_hi - t_lo);
+}
+
+// Transmission table for one airmass, rows of nwl+1 values per emission height
+const std::vector<float>* Atm_trans::table(double airmass)
+{
+    for(size_t i = 0; i < cache_airmass.size(); i++)
+    {
+        if(cache_airmass[i] == airmass)
+            return &cache_table[i];
+    }
+    if(nz == 0)
+        return NULL;
+
+    size_t k;
+    if(cache_airmass.size() < 4)
+    {
+        k = cache_airmass.size();
+        cache_airmass.push_back(airmass);
+        cache_table.push_back(std::vector<float>());
+    }
+    else
+    {
+        k = cache_next;
+        cache_next = (cache_next + 1) % 4;
+        cache_airmass[k] = airmass;
+    }
+    std::vector<float>& t = cache_table[k];
+    t.resize(nz * (nwl + 1));
+    for(int iz = 0; iz < nz; iz++)
+    {
+        double h = (z0 + iz / dzi) * 1e-5;
+        double sum = 0., sum_w = 0.;
+        for(int iw = 0; iw < nwl; iw++)
+        {
+            double wl = wl0 + iw / dwli;
+            double tr = exp(-airmass * vertical_tau(h, wl));
+            t[iz * (nwl + 1) + iw] = tr;
+            if(wl >= wl_min && wl <= wl_max)
+            {
+                sum += tr / (wl * wl);
+                sum_w += 1. / (wl * wl);
+            }
+        }
+        t[iz * (nwl + 1) + nwl] = (sum_w > 0.) ? sum / sum_w : 1.;
+    }
+    return &t;
+}
+
+// zem [cm] a.s.l. and lambda [nm], lambda = 0 for unspecified
+double Atm_trans::transmission(double zem, double lambda, double airmass)
+{
+    float w;
+    struct bunch b;
+    memset(&b, 0, sizeof(b));
+    b.zem = zem;
+    b.lambda = lambda;
+    transmission(&b, 1, airmass, &w);
+    return w;
+}
+
+void Atm_trans::transmission(const struct bunch* bunches, int nbunches, double airmass, float* w)
+{
+    const std::vector<float>* tab = table(airmass);
+    if(tab == NULL)
+    {
+        std::fill(w, w + nbunches, 1.f);
+        return;
+    }
+    const float* t = tab->data();
+    int stride = nwl + 1;
+    for(int i = 0; i < nbunches; i++)
+    {
+        double u = (bunches[i].zem - z0) * dzi;
+        u = std::min(std::max(u, 0.), (double) (nz - 1));
+        int iz = std::min((int) u, nz - 2);
+        double fz = u - iz;
+        double v = (bunches[i].lambda - wl0) * dwli;
+        v = std::min(std::max(v, 0.), (double) (nwl - 1));
+        int iw = std::min((int) v, nwl - 2);
+        double fw = v - iw;
+        // lambda = 0: use the spectrum-averaged column
+        int unspec = (bunches[i].lambda <= 0.f);
+        iw = unspec ? nwl : iw;
+        int iw2 = unspec ? nwl : iw + 1;
+        const float* r1 = t + iz * stride;
+        const float* r2 = r1 + stride;
+        double a = (1. - fw) * r1[iw] + fw * r1[iw2];
+        double b = (1. - fw) * r2[iw] + fw * r2[iw2];
+        w[i] = (1. - fz) * a + fz * b;
+    }
+}
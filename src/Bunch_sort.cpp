@@ -0,0 +1,86 @@
+#include "Bunch_sort.h"
+#include <algorithm>
+#include <cstring>
+
+Bunch_sort::Bunch_sort()
+{
+
+}
+
+Bunch_sort::~Bunch_sort()
+{
+
+}
+
+// Order-preserving map of a float to an unsigned int: negative values are
+// inverted, positive values get the sign bit set
+static inline uint32_t float_key(float f)
+{
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    uint32_t mask = (uint32_t) (-(int32_t) (u >> 31)) | 0x80000000u;
+    return u ^ mask;
+}
+
+void Bunch_sort::sort_time(struct bunch* bunches, int nbunches)
+{
+    if(nbunches < 2)
+        return;
+    size_t n = nbunches;
+    key.resize(n);
+    key2.resize(n);
+    idx.resize(n);
+    idx2.resize(n);
+
+    // histograms of the 4 bytes in one pass
+    uint32_t count[4][256];
+    memset(count, 0, sizeof(count));
+    bool sorted = true;
+    for(size_t i = 0; i < n; i++)
+    {
+        uint32_t k = float_key(bunches[i].ctime);
+        key[i] = k;
+        idx[i] = i;
+        sorted = sorted && (i == 0 || k >= key[i - 1]);
+        count[0][k & 0xff]++;
+        count[1][(k >> 8) & 0xff]++;
+        count[2][(k >> 16) & 0xff]++;
+        count[3][k >> 24]++;
+    }
+    if(sorted)
+        return;
+
+    uint32_t* k_in = key.data();
+    uint32_t* k_out = key2.data();
+    uint32_t* i_in = idx.data();
+    uint32_t* i_out = idx2.data();
+    for(int pass = 0; pass < 4; pass++)
+    {
+        uint32_t* c = count[pass];
+        int shift = pass * 8;
+        // all keys with the same byte: nothing to do
+        if(c[(k_in[0] >> shift) & 0xff] == n)
+            continue;
+        uint32_t sum = 0;
+        for(int b = 0; b < 256; b++)
+        {
+            uint32_t t = c[b];
+            c[b] = sum;
+            sum += t;
+        }
+        for(size_t i = 0; i < n; i++)
+        {
+            uint32_t k = k_in[i];
+            uint32_t p = c[(k >> shift) & 0xff]++;
+            k_out[p] = k;
+            i_out[p] = i_in[i];
+        }
+        std::swap(k_in, k_out);
+        std::swap(i_in, i_out);
+    }
+
+    tmp.resize(n);
+    for(size_t i = 0; i < n; i++)
+        tmp[i] = bunches[i_in[i]];
+    memcpy(bunches, tmp.data(), n * sizeof(struct bunch));
+}
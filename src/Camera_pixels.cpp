@@ -0,0 +1,228 @@
+#include "Camera_pixels.h"
+#include "rec_tools.h"
+#include <cmath>
+#include <algorithm>
+
+Camera_pixels::Camera_pixels()
+{
+    clear();
+}
+
+Camera_pixels::~Camera_pixels()
+{
+
+}
+
+void Camera_pixels::clear()
+{
+    npix = 0;
+    flen = 1.;
+    xpix.clear();
+    ypix.clear();
+    shape.clear();
+    half_size.clear();
+    x_low = x_high = y_low = y_high = 0.;
+    dxm1 = dym1 = 0.;
+    nx = ny = 0;
+    grid_first.clear();
+    grid_pix.clear();
+}
+
+int Camera_pixels::add_pixel(double x, double y, int pixel_shape, double hs)
+{
+    xpix.push_back(x);
+    ypix.push_back(y);
+    shape.push_back(pixel_shape);
+    half_size.push_back(hs);
+    return npix++;
+}
+
+// nrings rings of hexagonal pixels around a central one, pixel_size is flat-to-flat
+void Camera_pixels::set_hex_camera(int nrings, double pixel_size, int pixel_shape)
+{
+    clear();
+    for(int r = -nrings; r <= nrings; r++)
+    {
+        for(int q = -nrings; q <= nrings; q++)
+        {
+            if(std::abs(q + r) > nrings)
+                continue;
+            // neighbours across the flat sides, i.e. along x for shape 1
+            double u = pixel_size * (q + 0.5 * r);
+            double v = pixel_size * (0.5 * sqrt(3.) * r);
+            if(pixel_shape == 3)
+                add_pixel(v, u, 3, 0.5 * pixel_size);
+            else
+                add_pixel(u, v, 1, 0.5 * pixel_size);
+        }
+    }
+    setup_grid();
+}
+
+void Camera_pixels::set_square_camera(int nrows, double pixel_size)
+{
+    clear();
+    double off = 0.5 * (nrows - 1) * pixel_size;
+    for(int j = 0; j < nrows; j++)
+    {
+        for(int i = 0; i < nrows; i++)
+        {
+            add_pixel(i * pixel_size - off, j * pixel_size - off, 2, 0.5 * pixel_size);
+        }
+    }
+    setup_grid();
+}
+
+static double outer_radius(int pixel_shape, double hs)
+{
+    switch(pixel_shape)
+    {
+        case 0:
+            return hs;
+        case 2:
+            return hs * sqrt(2.);
+        default:
+            return hs * 2. / sqrt(3.);
+    }
+}
+
+static bool inside_pixel(int pixel_shape, double hs, double dx, double dy)
+{
+    dx = fabs(dx);
+    dy = fabs(dy);
+    switch(pixel_shape)
+    {
+        case 0:
+            return dx * dx + dy * dy <= hs * hs;
+        case 1:
+            return dx <= hs && 0.5 * dx + 0.5 * sqrt(3.) * dy <= hs;
+        case 2:
+            return dx <= hs && dy <= hs;
+        case 3:
+            return dy <= hs && 0.5 * dy + 0.5 * sqrt(3.) * dx <= hs;
+        default:
+            return false;
+    }
+}
+
+// grid elements about the size of the smallest pixel, each listing the pixels touching it
+void Camera_pixels::setup_grid()
+{
+    grid_first.clear();
+    grid_pix.clear();
+    nx = ny = 0;
+    if(npix <= 0)
+        return;
+
+    double rmin = outer_radius(shape[0], half_size[0]);
+    x_low = x_high = xpix[0];
+    y_low = y_high = ypix[0];
+    for(int i = 0; i < npix; i++)
+    {
+        double r = outer_radius(shape[i], half_size[i]);
+        rmin = std::min(rmin, r);
+        x_low = std::min(x_low, xpix[i] - r);
+        x_high = std::max(x_high, xpix[i] + r);
+        y_low = std::min(y_low, ypix[i] - r);
+        y_high = std::max(y_high, ypix[i] + r);
+    }
+    double cell = (rmin > 0.) ? rmin : 0.5 * std::max(x_high - x_low, y_high - y_low);
+    nx = std::max(1, (int) ceil((x_high - x_low) / cell));
+    ny = std::max(1, (int) ceil((y_high - y_low) / cell));
+    dxm1 = nx / (x_high - x_low);
+    dym1 = ny / (y_high - y_low);
+
+    // two passes: count, then fill
+    grid_first.assign(nx * ny + 1, 0);
+    for(int pass = 0; pass < 2; pass++)
+    {
+        std::vector<int> next;
+        if(pass == 1)
+        {
+            for(int k = 0; k < nx * ny; k++)
+                grid_first[k + 1] += grid_first[k];
+            grid_pix.resize(grid_first[nx * ny]);
+            next.assign(grid_first.begin(), grid_first.end() - 1);
+        }
+        for(int i = 0; i < npix; i++)
+        {
+            double r = outer_radius(shape[i], half_size[i]);
+            int ix1 = std::max(0, (int) ((xpix[i] - r - x_low) * dxm1));
+            int ix2 = std::min(nx - 1, (int) ((xpix[i] + r - x_low) * dxm1));
+            int iy1 = std::max(0, (int) ((ypix[i] - r - y_low) * dym1));
+            int iy2 = std::min(ny - 1, (int) ((ypix[i] + r - y_low) * dym1));
+            for(int iy = iy1; iy <= iy2; iy++)
+            {
+                for(int ix = ix1; ix <= ix2; ix++)
+                {
+                    if(pass == 0)
+                        grid_first[iy * nx + ix + 1]++;
+                    else
+                        grid_pix[next[iy * nx + ix]++] = i;
+                }
+            }
+        }
+    }
+}
+
+// pixel number hit at (x,y) or -1
+int Camera_pixels::find_pixel(double x, double y) const
+{
+    if(!(x >= x_low && x < x_high && y >= y_low && y < y_high))
+        return -1;
+    int ix = (int) ((x - x_low) * dxm1);
+    int iy = (int) ((y - y_low) * dym1);
+    if(ix >= nx || iy >= ny)
+        return -1;
+    int k = iy * nx + ix;
+    for(int j = grid_first[k]; j < grid_first[k + 1]; j++)
+    {
+        int i = grid_pix[j];
+        if(inside_pixel(shape[i], half_size[i], x - xpix[i], y - ypix[i]))
+            return i;
+    }
+    return -1;
+}
+
+// Add the photons of all bunches to the pixels they hit, for an ideal telescope
+// pointing to az/alt [rad] (parallel projection of the bunch direction, no imaging errors).
+void Camera_pixels::fill_image(const struct bunch* bunches, int nbunches, double az, double alt, double* image) const
+{
+    const PointingTrans* pt = get_pointing_trans(az, alt);
+    for(int i = 0; i < nbunches; i++)
+    {
+        // source direction in the CORSIKA frame (x north, y west, z up)
+        double sx = -bunches[i].cx;
+        double sy = -bunches[i].cy;
+        double sz2 = 1. - sx * sx - sy * sy;
+        if(sz2 <= 0.)
+            continue;
+        double sz = sqrt(sz2);
+        // as angles_to_offset, with vectors instead of angles
+        double xp0 = -(sx * pt->cos_az - sy * pt->sin_az);
+        double yp0 = -sy * pt->cos_az - sx * pt->sin_az;
+        double xp1 = pt->sin_alt * xp0 + pt->cos_alt * sz;
+        double zp1 = -pt->cos_alt * xp0 + pt->sin_alt * sz;
+        if(zp1 <= 0.)
+            continue;
+        int ipix = find_pixel(flen * xp1 / zp1, flen * yp0 / zp1);
+        if(ipix >= 0)
+            image[ipix] += bunches[i].photons;
+    }
+}
+
+// One image per telescope, telescopes are processed in parallel
+void Camera_pixels::fill_images(int ntel, const Camera_pixels* const* cams, const struct bunch* const* bunches,
+                                const int* nbunches, double az, double alt, double* const* images)
+{
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int itel = 0; itel < ntel; itel++)
+    {
+        if(cams[itel] == NULL || images[itel] == NULL)
+            continue;
+        std::fill(images[itel], images[itel] + cams[itel]->npix, 0.);
+        cams[itel]->fill_image(bunches[itel], nbunches[itel], az, alt, images[itel]);
+    }
+}
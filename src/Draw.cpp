@@ -1,15 +1,496 @@
 #include "Photon_bunches.h"
 #include "TTree.h"
 #include "TFile.h"
+#include "TNamed.h"
 #include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <cstdio>
+#include <climits>
+#include <cerrno>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "TH1D.h"
+#include "TH2D.h"
+#include "TH3D.h"
 #include "TMath.h"
+#include "TROOT.h"
+#include "ROOT/RDataFrame.hxx"
+#include "ROOT/RDFHelpers.hxx"
 #include "events.h"
+#include "Hist_defs.h"
+#include "Lateral_fit.h"
+#include "Tdigest.h"
+#include "Spectral_weights.h"
 
+// Weight of one target spectrum (include/Spectral_weights.h). The entries of
+// one shower follow each other; each slot computes the weights of all targets
+// when the energy changes, shared by the columns of the targets.
+class Spectral_column
+{
+    public:
+    struct last_weights
+    {
+        Spectral_weights sw;
+        double energy;
+        std::vector<double> w;
+    };
+    std::shared_ptr<std::vector<last_weights> > last;
+    size_t k;
+
+    Spectral_column(std::shared_ptr<std::vector<last_weights> > l, size_t target)
+    {
+        last = l;
+        k = target;
+    }
+    double operator()(unsigned slot, double energy, double gen_index, double gen_emin, double gen_emax) const
+    {
+        last_weights& l = (*last)[slot];
+        if(gen_index != l.sw.gen_index || gen_emin != l.sw.e_min || gen_emax != l.sw.e_max)
+        {
+            l.sw.set_generation(gen_index, gen_emin, gen_emax);
+            l.energy = -1.;
+        }
+        if(energy != l.energy)
+        {
+            l.sw.weights(&energy, 1, l.w.data());
+            l.energy = energy;
+        }
+        return l.w[k];
+    }
+};
+
+// t-digests of the bunch time and emission height per telescope and rc bin,
+// weighted with the photons of the bunches
+class Bunch_quantiles
+{
+    public:
+    int nrc;
+    double rc_max;
+    std::vector<Tdigest> d;     // [(itel * nrc + irc) * 2 + var], var 0: time, 1: p_height
+
+    Bunch_quantiles(int n = 0, double r = 0.)
+    {
+        nrc = n;
+        rc_max = r;
+    }
+    void fill(int itel, double rc, double time, double p_height, double w)
+    {
+        if(itel < 0 || !(rc >= 0.) || !(rc < rc_max))
+            return;
+        size_t k = ((size_t) itel * nrc + (size_t) (rc / rc_max * nrc)) * 2;
+        if(k + 2 > d.size())
+            d.resize(k + 2);
+        d[k].add(time, w);
+        d[k + 1].add(p_height, w);
+    }
+    void merge(const Bunch_quantiles& o)
+    {
+        if(o.d.size() > d.size())
+            d.resize(o.d.size());
+        for(size_t k = 0; k < o.d.size(); k++)
+        {
+            if(!o.d[k].empty())
+                d[k].merge(o.d[k]);
+        }
+    }
+};
+
+// RDataFrame action filling one Bunch_quantiles per slot, merged at the end
+class Quantile_action : public ROOT::Detail::RDF::RActionImpl<Quantile_action>
+{
+    public:
+    using Result_t = Bunch_quantiles;
+    std::shared_ptr<Bunch_quantiles> result;
+    std::vector<Bunch_quantiles> slots;
+
+    Quantile_action(unsigned nslots, int nrc, double rc_max)
+    {
+        result = std::make_shared<Bunch_quantiles>(nrc, rc_max);
+        slots.assign(nslots, Bunch_quantiles(nrc, rc_max));
+    }
+    Quantile_action(Quantile_action&&) = default;
+    Quantile_action(const Quantile_action&) = delete;
+    void Initialize() {}
+    void InitTask(TTreeReader*, unsigned int) {}
+    void Exec(unsigned int slot, int itel, double rc, double time, double p_height, double nbunch)
+    {
+        slots[slot].fill(itel, rc, time, p_height, nbunch);
+    }
+    void Finalize()
+    {
+        for(size_t i = 0; i < slots.size(); i++)
+            result->merge(slots[i]);
+        slots.clear();
+    }
+    std::shared_ptr<Bunch_quantiles> GetResultPtr() const
+    {
+        return result;
+    }
+    std::string GetActionName()
+    {
+        return "Bunch_quantiles";
+    }
+};
+
+// Histograms booked for one set of input files
+class Booked
+{
+    public:
+    std::vector<ROOT::RDataFrame*> frames;
+    std::vector<std::string> trees;
+    std::vector<std::vector<std::string> > branches;
+    std::vector<ROOT::RDF::RNode> bases;
+    std::vector<ROOT::RDF::RResultPtr<TH1D> > h1;
+    std::vector<ROOT::RDF::RResultPtr<TH2D> > h2;
+    std::vector<ROOT::RDF::RResultPtr<TH3D> > h3;
+    // event_data columns for the lateral fits
+    ROOT::RDF::RResultPtr<std::vector<int> > fit_run, fit_id;
+    ROOT::RDF::RResultPtr<std::vector<double> > fit_rc, fit_photons, fit_area;
+    ROOT::RDF::RResultPtr<Bunch_quantiles> quantiles;
+    const Spectral_weights* spectra;    // "w_<name>" columns in event_data, may be NULL
+
+    Booked()
+    {
+        spectra = NULL;
+    }
+    Booked(const Booked&) = delete;
+    Booked& operator=(const Booked&) = delete;
+    ~Booked()
+    {
+        for(size_t i = 0; i < frames.size(); i++)
+            delete frames[i];
+    }
+    // Index of the chain of a tree over the files, with the "area" and spectral weight columns
+    size_t base(const std::string& tree, const std::vector<std::string>& files, double area)
+    {
+        for(size_t it = 0; it < trees.size(); it++)
+        {
+            if(trees[it] == tree)
+                return it;
+        }
+        ROOT::RDataFrame* df = new ROOT::RDataFrame(tree, files);
+        frames.push_back(df);
+        std::vector<std::string> br = df->GetColumnNames();
+        ROOT::RDF::RNode node = *df;
+        if(std::find(br.begin(), br.end(), "area") == br.end())
+        {
+            // collection area of each telescope: cross-section pi*rtel^2 of the CORSIKA detection
+            // sphere, the same at any zenith angle; the fixed area for entries without rtel
+            if(std::find(br.begin(), br.end(), "rtel") != br.end())
+                node = node.Define("area", [area](double rtel) { return (rtel > 0.) ? TMath::Pi() * rtel * rtel : area; },
+                                   {"rtel"});
+            else
+                node = node.Define("area", [area]() { return area; });
+        }
+        if(spectra != NULL && !spectra->names.empty() && tree == "event_data")
+        {
+            const char* cols[4] = {"energy", "gen_index", "gen_emin", "gen_emax"};
+            bool has_energy = true;
+            for(int i = 0; i < 4; i++)
+                has_energy = has_energy && std::find(br.begin(), br.end(), cols[i]) != br.end();
+            if(has_energy)
+            {
+                Spectral_column::last_weights l;
+                l.sw = *spectra;
+                l.sw.set_generation(-1., 0., 0.);
+                l.energy = -1.;
+                l.w.assign(spectra->names.size(), 0.);
+                auto last = std::make_shared<std::vector<Spectral_column::last_weights> >(df->GetNSlots(), l);
+                for(size_t k = 0; k < spectra->names.size(); k++)
+                    node = node.DefineSlot("w_" + spectra->names[k], Spectral_column(last, k),
+                                           {"energy", "gen_index", "gen_emin", "gen_emax"});
+            }
+            else
+            {
+                std::cout << "No shower energy in event_data (older file?), no spectral weights" << std::endl;
+            }
+        }
+        trees.push_back(tree);
+        branches.push_back(br);
+        bases.push_back(node);
+        return trees.size() - 1;
+    }
+    TH1* hist(const Hist_defs& hd, size_t i)
+    {
+        if(hd.defs[i].dim == 1)
+            return h1[i].GetPtr();
+        else if(hd.defs[i].dim == 2)
+            return h2[i].GetPtr();
+        return h3[i].GetPtr();
+    }
+};
+
+// Column for an expression: a branch is used as it is, anything else is defined once per node
+static std::string column(ROOT::RDF::RNode& node, const std::vector<std::string>& branches,
+                          const std::string& expr, const std::string& col)
+{
+    if(std::find(branches.begin(), branches.end(), expr) != branches.end())
+        return expr;
+    node = node.Define(col, expr);
+    return col;
+}
+
+// Books all histograms over the files, one RDataFrame chain per tree; throws on bad expressions
+static void book(const Hist_defs& hd, const std::vector<std::string>& files, double area, Booked& b,
+                 std::vector<ROOT::RDF::RResultHandle>& handles)
+{
+    b.h1.resize(hd.defs.size());
+    b.h2.resize(hd.defs.size());
+    b.h3.resize(hd.defs.size());
+    std::vector<std::string> trees = hd.trees();
+    for(size_t it = 0; it < trees.size(); it++)
+    {
+        size_t ib = b.base(trees[it], files, area);
+        ROOT::RDF::RNode base = b.bases[ib];
+        const std::vector<std::string>& branches = b.branches[ib];
+        // one filter per distinct selection, shared by its histograms
+        std::map<std::string, ROOT::RDF::RNode> selected;
+        for(size_t i = 0; i < hd.defs.size(); i++)
+        {
+            const Hist_def& d = hd.defs[i];
+            if(d.tree != trees[it])
+                continue;
+            std::map<std::string, ROOT::RDF::RNode>::iterator sel = selected.find(d.cut);
+            if(sel == selected.end())
+            {
+                ROOT::RDF::RNode f = base;
+                if(!d.cut.empty())
+                    f = base.Filter(d.cut);
+                sel = selected.insert(std::make_pair(d.cut, f)).first;
+            }
+            ROOT::RDF::RNode& node = sel->second;
+
+            std::string tag = "hdef" + std::to_string(i) + "_";
+            std::string col[3], w;
+            for(int k = 0; k < d.dim; k++)
+                col[k] = column(node, branches, d.expr[k], tag + "xyz"[k]);
+            if(!d.weight.empty())
+                w = column(node, branches, d.weight, tag + "w");
+            if(d.dim == 1)
+            {
+                ROOT::RDF::TH1DModel m(d.name.c_str(), d.title.c_str(), d.nbins[0], d.lo[0], d.hi[0]);
+                b.h1[i] = w.empty() ? node.Histo1D(m, col[0]) : node.Histo1D(m, col[0], w);
+                handles.push_back(b.h1[i]);
+            }
+            else if(d.dim == 2)
+            {
+                ROOT::RDF::TH2DModel m(d.name.c_str(), d.title.c_str(), d.nbins[0], d.lo[0], d.hi[0],
+                                       d.nbins[1], d.lo[1], d.hi[1]);
+                b.h2[i] = w.empty() ? node.Histo2D(m, col[0], col[1]) : node.Histo2D(m, col[0], col[1], w);
+                handles.push_back(b.h2[i]);
+            }
+            else
+            {
+                ROOT::RDF::TH3DModel m(d.name.c_str(), d.title.c_str(), d.nbins[0], d.lo[0], d.hi[0],
+                                       d.nbins[1], d.lo[1], d.hi[1], d.nbins[2], d.lo[2], d.hi[2]);
+                b.h3[i] = w.empty() ? node.Histo3D(m, col[0], col[1], col[2])
+                                    : node.Histo3D(m, col[0], col[1], col[2], w);
+                handles.push_back(b.h3[i]);
+            }
+        }
+    }
+}
+
+// Books the points of the lateral fits, one per event_data entry
+static void book_fit(const std::vector<std::string>& files, double area, Booked& b,
+                     std::vector<ROOT::RDF::RResultHandle>& handles)
+{
+    size_t ib = b.base("event_data", files, area);
+    ROOT::RDF::RNode node = b.bases[ib];
+    // the event number restarts in each CORSIKA run; older files without "run" count as one run
+    if(std::find(b.branches[ib].begin(), b.branches[ib].end(), "run") == b.branches[ib].end())
+    {
+        std::cout << "No run number in event_data (older file?), showers of different runs may be merged" << std::endl;
+        node = node.Define("run", []() { return 0; });
+    }
+    b.fit_run = node.Take<int>("run");
+    b.fit_id = node.Take<int>("run_id");
+    b.fit_rc = node.Take<double>("rc");
+    b.fit_photons = node.Take<double>("photons");
+    b.fit_area = node.Take<double>("area");
+    handles.push_back(b.fit_run);
+    handles.push_back(b.fit_id);
+    handles.push_back(b.fit_rc);
+    handles.push_back(b.fit_photons);
+    handles.push_back(b.fit_area);
+}
+
+// Books the quantile sketches of the bunch tree
+static void book_quantiles(const std::vector<std::string>& files, double area, int nrc, double rc_max, Booked& b,
+                           std::vector<ROOT::RDF::RResultHandle>& handles)
+{
+    size_t ib = b.base("bunch", files, area);
+    b.quantiles = b.bases[ib].Book<int, double, double, double, double>(
+                        Quantile_action(b.frames[ib]->GetNSlots(), nrc, rc_max),
+                        {"itel", "rc", "time", "p_height", "nbunch"});
+    handles.push_back(b.quantiles);
+}
+
+// Writes the sketches to a tree "quantiles", one entry per telescope, rc bin and variable
+static void write_quantiles(Bunch_quantiles& bq)
+{
+    int itel, irc, var;
+    double rc_lo, rc_hi, weight, min, max, q10, q50, q90;
+    std::vector<double> c_mean, c_weight;
+    TTree* q_data = new TTree("quantiles", "t-digests of bunch time (var 0) and p_height (var 1)");
+    q_data->Branch("itel", &itel);
+    q_data->Branch("irc", &irc);
+    q_data->Branch("rc_lo", &rc_lo);
+    q_data->Branch("rc_hi", &rc_hi);
+    q_data->Branch("var", &var);
+    q_data->Branch("weight", &weight);
+    q_data->Branch("min", &min);
+    q_data->Branch("max", &max);
+    q_data->Branch("q10", &q10);
+    q_data->Branch("q50", &q50);
+    q_data->Branch("q90", &q90);
+    q_data->Branch("mean", &c_mean);
+    q_data->Branch("cweight", &c_weight);
+    for(size_t k = 0; k < bq.d.size(); k++)
+    {
+        Tdigest& t = bq.d[k];
+        if(t.empty())
+            continue;
+        var = k % 2;
+        irc = (k / 2) % bq.nrc;
+        itel = k / 2 / bq.nrc;
+        rc_lo = irc * bq.rc_max / bq.nrc;
+        rc_hi = (irc + 1) * bq.rc_max / bq.nrc;
+        q10 = t.quantile(0.1);
+        q50 = t.quantile(0.5);
+        q90 = t.quantile(0.9);
+        weight = t.total;
+        min = t.min;
+        max = t.max;
+        c_mean = t.mean;
+        c_weight = t.weight;
+        q_data->Fill();
+    }
+    q_data->Write();
+}
+
+// Adds h to the merged histogram sum[i]
+static void add(std::vector<TH1*>& sum, size_t i, TH1* h)
+{
+    if(sum[i] == NULL)
+    {
+        sum[i] = (TH1*) h->Clone();
+        sum[i]->SetDirectory(0);
+    }
+    else
+    {
+        sum[i]->Add(h);
+    }
+}
+
+// Cache entry of an input file: name of the cache file and the full key stored in it,
+// empty if the file cannot be stat'ed (e.g. remote files, which are never cached)
+static std::string cache_name(const std::string& dir, const std::string& in_file, const std::string& defs_key,
+                              std::string& key)
+{
+    struct stat st;
+    char path[PATH_MAX];
+    key.clear();
+    if(stat(in_file.c_str(), &st) != 0 || realpath(in_file.c_str(), path) == NULL)
+        return "";
+    char buf[128];
+    snprintf(buf, sizeof(buf), "\n%lld\n%lld.%09ld\n", (long long) st.st_size, (long long) st.st_mtim.tv_sec,
+             (long) st.st_mtim.tv_nsec);
+    key = std::string("Draw cache 4\n") + path + buf + defs_key;
+    // the name only depends on the path and the definitions, so the entry of a
+    // changed input file fails the key check and is overwritten in place (FNV-1a)
+    std::string name_key = std::string("Draw cache 4\n") + path + "\n" + defs_key;
+    unsigned long long h = 14695981039346656037ULL;
+    for(size_t i = 0; i < name_key.size(); i++)
+    {
+        h ^= (unsigned char) name_key[i];
+        h *= 1099511628211ULL;
+    }
+    snprintf(buf, sizeof(buf), "/%016llx.root", h);
+    return dir + buf;
+}
+
+// Adds the cached histograms to sum; returns 0 if ok, -1 if missing, stale or unreadable
+static int read_cache(const std::string& cache_file, const std::string& key, const Hist_defs& hd,
+                      std::vector<TH1*>& sum)
+{
+    struct stat st;
+    if(stat(cache_file.c_str(), &st) != 0)
+        return -1;
+    TFile* f = TFile::Open(cache_file.c_str(), "READ");
+    if(f == NULL || f->IsZombie())
+    {
+        delete f;
+        return -1;
+    }
+    TNamed* k = (TNamed*) f->Get("cache_key");
+    std::vector<TH1*> h(hd.defs.size(), (TH1*) NULL);
+    bool ok = (k != NULL && key == k->GetTitle());
+    for(size_t i = 0; ok && i < hd.defs.size(); i++)
+    {
+        h[i] = (TH1*) f->Get(hd.defs[i].name.c_str());
+        ok = (h[i] != NULL);
+    }
+    if(ok)
+    {
+        for(size_t i = 0; i < hd.defs.size(); i++)
+            add(sum, i, h[i]);
+    }
+    f->Close();
+    delete f;
+    return ok ? 0 : -1;
+}
+
+// Writes the histograms of one input file to its cache file (via a temporary file and rename;
+// the pid in its name keeps concurrent runs on the same cache directory apart)
+static void write_cache(const std::string& cache_file, const std::string& key, const Hist_defs& hd, Booked& b)
+{
+    std::string tmp = cache_file + "." + std::to_string((long) getpid()) + ".tmp";
+    TFile* f = new TFile(tmp.c_str(), "RECREATE");
+    if(f->IsZombie())
+    {
+        std::cout << "Cannot write the cache file " << tmp << std::endl;
+        delete f;
+        return;
+    }
+    TNamed k("cache_key", key.c_str());
+    k.Write();
+    for(size_t i = 0; i < hd.defs.size(); i++)
+        b.hist(hd, i)->Write(hd.defs[i].name.c_str());
+    f->Close();
+    delete f;
+    if(rename(tmp.c_str(), cache_file.c_str()) != 0)
+        perror(cache_file.c_str());
+}
+
+// Histograms from a list of definitions over all input files. Each tree used
+// by the definitions is read as one RDataFrame chain; all histograms of all
+// trees are filled in a single pass (RunGraphs), reading only the branches
+// their expressions use. With implicit multi-threading each thread fills its
+// own copy of the histograms, which are merged at the end.
+// With --cache the histograms of each input file are kept in a cache directory
+// and only new or changed files are read again.
+// With --quantiles the median and 10/90% quantiles of the bunch time and
+// emission height per telescope and rc bin come from t-digests (include/Tdigest.h).
+// With --fit_lateral the lateral distribution of each shower is fitted (see
+// include/Lateral_fit.h); the points are collected in the same pass.
+// With --spectrum each target spectrum gives a weight column "w_<name>" in
+// event_data (include/Spectral_weights.h), e.g. for w=w_crab in the definitions.
 int main(int argc, char** argv)
 {
     std::string out_file = "out.root";
-    const char*  in_file;
+    const char* hist_file = NULL;
+    const char* cache_dir = NULL;
+    int nthreads = 0;       // 0: all cores
+    int fit_lateral = 0;
+    int q_nrc = 0;          // rc bins of the quantile sketches, 0: none
+    double q_rc_max = 0.;
+    Spectral_weights spectra;
 
     while(argc > 1)
     {
@@ -20,41 +501,232 @@ int main(int argc, char** argv)
             argv += 2;
             continue;
         }
+        // number of threads, 1 for sequential processing
+        else if(strcmp(argv[1], "--threads") == 0 && argc > 2)
+        {
+            nthreads = atoi(argv[2]);
+            argc -= 2;
+            argv += 2;
+            continue;
+        }
+        // histogram definitions, see include/Hist_defs.h
+        else if(strcmp(argv[1], "--hists") == 0 && argc > 2)
+        {
+            hist_file = argv[2];
+            argc -= 2;
+            argv += 2;
+            continue;
+        }
+        // per input file histograms, keyed by path, size, mtime and definitions
+        else if(strcmp(argv[1], "--cache") == 0 && argc > 2)
+        {
+            cache_dir = argv[2];
+            argc -= 2;
+            argv += 2;
+            continue;
+        }
+        // quantile sketches of time and p_height in <n> rc bins up to <rc_max>
+        else if(strcmp(argv[1], "--quantiles") == 0 && argc > 3)
+        {
+            q_nrc = atoi(argv[2]);
+            q_rc_max = atof(argv[3]);
+            if(q_nrc < 1 || !(q_rc_max > 0.))
+            {
+                std::cout << "Bad --quantiles " << argv[2] << " " << argv[3] << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            argc -= 3;
+            argv += 3;
+            continue;
+        }
+        // target spectrum name:index[:beta[:e0]], column "w_<name>" in event_data; may be repeated
+        else if(strcmp(argv[1], "--spectrum") == 0 && argc > 2)
+        {
+            if(spectra.add_target(argv[2]) != 0)
+                exit(EXIT_FAILURE);
+            argc -= 2;
+            argv += 2;
+            continue;
+        }
+        // NKG-like fit of the photons per telescope of each shower, tree "lateral_fit"
+        else if(strcmp(argv[1], "--fit_lateral") == 0)
+        {
+            fit_lateral = 1;
+            argc -= 1;
+            argv += 1;
+            continue;
+        }
         else
         {
             break;
         }
     }
 
-    TFile* h_file = new TFile(out_file.c_str(), "RECREATE");
-    TH1D* h1 = new TH1D("h1", "photon_density",30, 0, 600);
-    TH1D* h2 = new TH1D("h2", "density_with_weight",30, 0, 600);
-    while(argc > 1 || in_file != NULL)
+    std::vector<std::string> in_files;
+    for(int i = 1; i < argc; i++)
+        in_files.push_back(argv[i]);
+    if(in_files.empty())
     {
-        in_file = argv[1];
-        double area = TMath::Pi() * pow(5*cos(10*TMath::DegToRad()), 2);
-        TFile* root_file = new TFile(in_file, "READ");
-        in_file = NULL;
-        TTree* event_tree = (TTree*) root_file->Get("event_data");
-        auto event = new events();
-        event_tree->SetBranchAddress("event", &event);
-        for(int i = 0; i < event_tree->GetEntries(); i++)
-        {
-            event_tree->GetEntry(i);
-            h1->Fill(event->rc);
-            double n = event->photons ;
-            h2->Fill(event->rc,n/area);
-        }
+        std::cout << "Usage: Draw [--out_file <file>] [--threads <n>] [--hists <file>] [--cache <dir>] [--fit_lateral]"
+                  << " [--quantiles <n> <rc_max>] [--spectrum <name:index[:beta[:e0]]>]..."
+                  << " <input files>" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    Hist_defs hd;
+    if(hist_file != NULL)
+    {
+        if(hd.read(hist_file) != 0)
+            exit(EXIT_FAILURE);
+    }
+    else
+    {
+        hd.set_default();
+    }
 
-        root_file->Close();
-        h_file->cd();
-        h1->Write();
-        h2->Write();
-        h_file->Write();
-        h_file->Close();
-        argc--;
+    if(nthreads != 1)
+        ROOT::EnableImplicitMT(nthreads > 0 ? nthreads : 0);
 
+    // telescope area for files without rtel (the constant of the first versions of Draw)
+    double area = TMath::Pi() * pow(5*cos(10*TMath::DegToRad()), 2);
 
+    std::vector<TH1*> sum(hd.defs.size(), (TH1*) NULL);
+    size_t n_cached = 0;
+    Lateral_fit lf;
+    Bunch_quantiles bq;
+    try
+    {
+        if(cache_dir == NULL)
+        {
+            Booked b;
+            std::vector<ROOT::RDF::RResultHandle> handles;
+            b.spectra = &spectra;
+            book(hd, in_files, area, b, handles);
+            if(fit_lateral)
+                book_fit(in_files, area, b, handles);
+            if(q_nrc > 0)
+                book_quantiles(in_files, area, q_nrc, q_rc_max, b, handles);
+            // the event loops of all trees, run concurrently
+            ROOT::RDF::RunGraphs(handles);
+            for(size_t i = 0; i < hd.defs.size(); i++)
+                add(sum, i, b.hist(hd, i));
+            if(fit_lateral)
+                lf.set_points(*b.fit_run, *b.fit_id, *b.fit_rc, *b.fit_photons, *b.fit_area);
+            if(q_nrc > 0)
+                bq = *b.quantiles;
+        }
+        else
+        {
+            if(mkdir(cache_dir, 0755) != 0 && errno != EEXIST)
+            {
+                perror(cache_dir);
+                exit(EXIT_FAILURE);
+            }
+            // the fit points and the sketches are not cached, all files are read for them
+            if(fit_lateral || q_nrc > 0)
+            {
+                Booked b;
+                std::vector<ROOT::RDF::RResultHandle> handles;
+                b.spectra = &spectra;
+                if(fit_lateral)
+                    book_fit(in_files, area, b, handles);
+                if(q_nrc > 0)
+                    book_quantiles(in_files, area, q_nrc, q_rc_max, b, handles);
+                ROOT::RDF::RunGraphs(handles);
+                if(fit_lateral)
+                    lf.set_points(*b.fit_run, *b.fit_id, *b.fit_rc, *b.fit_photons, *b.fit_area);
+                if(q_nrc > 0)
+                    bq = *b.quantiles;
+            }
+            std::string defs_key = std::string("area=") + std::to_string(area) + "\n";
+            for(size_t k = 0; k < spectra.names.size(); k++)
+            {
+                char buf[256];
+                snprintf(buf, sizeof(buf), "spectrum=%s:%.17g:%.17g:%.17g\n", spectra.names[k].c_str(), spectra.index[k],
+                         spectra.beta[k], spectra.e0[k]);
+                defs_key += buf;
+            }
+            defs_key += hd.key();
+            std::vector<size_t> todo;
+            std::vector<std::string> cache_files(in_files.size()), keys(in_files.size());
+            for(size_t j = 0; j < in_files.size(); j++)
+            {
+                cache_files[j] = cache_name(cache_dir, in_files[j], defs_key, keys[j]);
+                if(!cache_files[j].empty() && read_cache(cache_files[j], keys[j], hd, sum) == 0)
+                    n_cached++;
+                else
+                    todo.push_back(j);
+            }
+            // the remaining files each get their own histograms, filled together
+            // in batches to bound the memory of the per-thread copies
+            const size_t batch = 16;
+            for(size_t j0 = 0; j0 < todo.size(); j0 += batch)
+            {
+                size_t j1 = std::min(todo.size(), j0 + batch);
+                std::vector<Booked> b(j1 - j0);
+                std::vector<ROOT::RDF::RResultHandle> handles;
+                for(size_t j = j0; j < j1; j++)
+                {
+                    b[j - j0].spectra = &spectra;
+                    book(hd, std::vector<std::string>(1, in_files[todo[j]]), area, b[j - j0], handles);
+                }
+                ROOT::RDF::RunGraphs(handles);
+                for(size_t j = j0; j < j1; j++)
+                {
+                    if(!cache_files[todo[j]].empty())
+                        write_cache(cache_files[todo[j]], keys[todo[j]], hd, b[j - j0]);
+                    for(size_t i = 0; i < hd.defs.size(); i++)
+                        add(sum, i, b[j - j0].hist(hd, i));
+                }
+            }
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cout << "Error while booking or filling the histograms: " << e.what() << std::endl;
+        exit(EXIT_FAILURE);
     }
 
-}
\ No newline at end of file
+    TFile* h_file = new TFile(out_file.c_str(), "RECREATE");
+    if(h_file->IsZombie())
+    {
+        std::cout << "Error while creating the new root file" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < hd.defs.size(); i++)
+        sum[i]->Write(hd.defs[i].name.c_str());
+    if(q_nrc > 0)
+        write_quantiles(bq);
+    if(fit_lateral)
+    {
+        lf.fit_all(nthreads);
+        Lateral_fit::result res;
+        TTree* fit_data = new TTree("lateral_fit", "lateral distribution fit per event");
+        fit_data->Branch("run", &res.run);
+        fit_data->Branch("event_id", &res.run_id);
+        fit_data->Branch("npoints", &res.npoints);
+        fit_data->Branch("status", &res.status);
+        fit_data->Branch("photons", &res.photons);
+        fit_data->Branch("lnA", &res.par[0]);
+        fit_data->Branch("s", &res.par[1]);
+        fit_data->Branch("r0", &res.par[2]);
+        fit_data->Branch("lnA_err", &res.err[0]);
+        fit_data->Branch("s_err", &res.err[1]);
+        fit_data->Branch("r0_err", &res.err[2]);
+        fit_data->Branch("nll", &res.nll);
+        fit_data->Branch("edm", &res.edm);
+        fit_data->Branch("nfcn", &res.nfcn);
+        for(size_t k = 0; k < lf.results.size(); k++)
+        {
+            res = lf.results[k];
+            fit_data->Fill();
+        }
+        fit_data->BuildIndex("run", "event_id");
+        fit_data->Write();
+        std::cout << "Fitted the lateral distribution of " << lf.results.size() << " events" << std::endl;
+    }
+    h_file->Close();
+    std::cout << "Filled " << hd.defs.size() << " histograms from " << in_files.size() << " files ("
+              << n_cached << " from the cache) with " << ROOT::GetThreadPoolSize() << " threads" << std::endl;
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "Ground_map.h"
+#include "TH2F.h"
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+Ground_map::Ground_map()
+{
+    nbins = 0;
+    size = dxi = 0.;
+}
+
+Ground_map::~Ground_map()
+{
+
+}
+
+// n x n bins over [-s, s] m
+void Ground_map::set(int n, double s)
+{
+    int nt = 1;
+#ifdef _OPENMP
+    nt = omp_get_max_threads();
+#endif
+    nbins = n;
+    size = s;
+    dxi = n / (2. * s);
+    grid.assign((size_t) n * n, 0.f);
+    // the per-thread grids are allocated by the threads that use them
+    tgrid.assign(nt, std::vector<float>());
+    trows.assign(nt, std::vector<char>());
+}
+
+void Ground_map::clear()
+{
+    std::fill(grid.begin(), grid.end(), 0.f);
+}
+
+// Bunches of one telescope at (x0, y0) [m] from the core, bunch positions in cm
+void Ground_map::fill(const struct bunch* bunches, int nbunches, double x0, double y0)
+{
+    if(nbunches <= 0 || nbins <= 0)
+        return;
+#ifdef _OPENMP
+#pragma omp parallel if(nbunches >= 20000)
+#endif
+    {
+        int it = 0;
+#ifdef _OPENMP
+        it = omp_get_thread_num();
+#endif
+        std::vector<float>& g = tgrid[it];
+        std::vector<char>& rows = trows[it];
+        if(g.empty())
+        {
+            g.assign((size_t) nbins * nbins, 0.f);
+            rows.assign(nbins, 0);
+        }
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+        for(int i = 0; i < nbunches; i++)
+        {
+            double x = (x0 + 0.01 * bunches[i].x + size) * dxi;
+            double y = (y0 + 0.01 * bunches[i].y + size) * dxi;
+            if(!(x >= 0. && x < nbins && y >= 0. && y < nbins))
+                continue;
+            int iy = (int) y;
+            g[(size_t) iy * nbins + (int) x] += bunches[i].photons;
+            rows[iy] = 1;
+        }
+    }
+}
+
+// Adds the per-thread grids to the map and clears them
+void Ground_map::merge()
+{
+    int nt = tgrid.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for(int iy = 0; iy < nbins; iy++)
+    {
+        float* out = &grid[(size_t) iy * nbins];
+        for(int it = 0; it < nt; it++)
+        {
+            if(trows[it].empty() || !trows[it][iy])
+                continue;
+            float* in = &tgrid[it][(size_t) iy * nbins];
+            for(int ix = 0; ix < nbins; ix++)
+                out[ix] += in[ix];
+            std::fill(in, in + nbins, 0.f);
+            trows[it][iy] = 0;
+        }
+    }
+}
+
+// Non-empty bins (iy * nbins + ix) and their photons
+void Ground_map::sparse(std::vector<int>& bins, std::vector<float>& photons) const
+{
+    bins.clear();
+    photons.clear();
+    for(size_t k = 0; k < grid.size(); k++)
+    {
+        if(grid[k] != 0.f)
+        {
+            bins.push_back(k);
+            photons.push_back(grid[k]);
+        }
+    }
+}
+
+// The map as a histogram, owned by the caller and not attached to a directory
+TH2F* Ground_map::hist(const char* name, const char* title) const
+{
+    TH2F* h = new TH2F(name, title, nbins, -size, size, nbins, -size, size);
+    h->SetDirectory(0);
+    for(int iy = 0; iy < nbins; iy++)
+    {
+        for(int ix = 0; ix < nbins; ix++)
+            h->SetBinContent(ix + 1, iy + 1, grid[(size_t) iy * nbins + ix]);
+    }
+    // (entries: non-empty bins)
+    h->SetEntries(std::count_if(grid.begin(), grid.end(), [](float v) { return v != 0.f; }));
+    return h;
+}
@@ -0,0 +1,118 @@
+#include "Hillas.h"
+#include "rec_tools.h"
+#include <cmath>
+#include <vector>
+
+Hillas_parameters::Hillas_parameters()
+{
+    clear();
+}
+
+Hillas_parameters::~Hillas_parameters()
+{
+
+}
+
+void Hillas_parameters::clear()
+{
+    size = cog_x = cog_y = 0.;
+    length = width = psi = disp = 0.;
+    npix = 0;
+}
+
+// One pass over the pixels for all first and second moments,
+// pixels below threshold do not contribute.
+// Returns the number of pixels used.
+int Hillas_parameters::compute(const Camera_pixels* cam, const double* image, double threshold)
+{
+    const double* x = cam->xpix.data();
+    const double* y = cam->ypix.data();
+    double sw = 0., sx = 0., sy = 0., sxx = 0., syy = 0., sxy = 0.;
+    int n = 0;
+
+    clear();
+#ifdef _OPENMP
+#pragma omp simd reduction(+:sw,sx,sy,sxx,syy,sxy,n)
+#endif
+    for(int i = 0; i < cam->npix; i++)
+    {
+        double w = (image[i] > threshold) ? image[i] : 0.;
+        n += (image[i] > threshold) ? 1 : 0;
+        sw += w;
+        sx += w * x[i];
+        sy += w * y[i];
+        sxx += w * x[i] * x[i];
+        syy += w * y[i] * y[i];
+        sxy += w * x[i] * y[i];
+    }
+    npix = n;
+    if(sw <= 0.)
+        return npix;
+
+    size = sw;
+    cog_x = sx / sw;
+    cog_y = sy / sw;
+    double vxx = sxx / sw - cog_x * cog_x;
+    double vyy = syy / sw - cog_y * cog_y;
+    double vxy = sxy / sw - cog_x * cog_y;
+    double d = vyy - vxx;
+    double z = sqrt(d * d + 4. * vxy * vxy);
+    double l2 = 0.5 * (vxx + vyy + z);
+    double w2 = 0.5 * (vxx + vyy - z);
+    length = (l2 > 0.) ? sqrt(l2) : 0.;
+    width = (w2 > 0.) ? sqrt(w2) : 0.;
+    psi = 0.5 * atan2(2. * vxy, vxx - vyy);
+    disp = (length > 0.) ? 1. - width / length : 0.;
+    return npix;
+}
+
+// Many images at once (e.g. all telescopes of an array), in parallel
+void Hillas_parameters::compute_all(int nimg, const Camera_pixels* const* cams, const double* const* images,
+                                    Hillas_parameters* hillas, double threshold)
+{
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for(int i = 0; i < nimg; i++)
+    {
+        if(cams[i] == NULL || images[i] == NULL)
+            hillas[i].clear();
+        else
+            hillas[i].compute(cams[i], images[i], threshold);
+    }
+}
+
+// shower_geometric_reconstruction from the images of one array event, all telescopes
+// pointing to az/alt [rad] and the nominal direction as reference.
+// Images below min_size are left out. Returns as shower_geometric_reconstruction,
+// or 0 with fewer than two usable images.
+int Hillas_parameters::reconstruct(int ntel, const Hillas_parameters* hillas, const Camera_pixels* const* cams,
+                                   const double* xtel, const double* ytel, const double* ztel,
+                                   double az, double alt, double min_size,
+                                   double* shower_az, double* shower_alt, double* xc, double* yc)
+{
+    std::vector<double> amp, ximg, yimg, phi, disp, xt, yt, zt, taz, talt, flen, rot;
+    for(int i = 0; i < ntel; i++)
+    {
+        if(cams[i] == NULL || hillas[i].size < min_size || hillas[i].length <= 0.)
+            continue;
+        amp.push_back(hillas[i].size);
+        ximg.push_back(hillas[i].cog_x);
+        yimg.push_back(hillas[i].cog_y);
+        phi.push_back(hillas[i].psi);
+        disp.push_back(hillas[i].disp);
+        xt.push_back(xtel[i]);
+        yt.push_back(ytel[i]);
+        zt.push_back(ztel[i]);
+        taz.push_back(az);
+        talt.push_back(alt);
+        flen.push_back(cams[i]->flen);
+        rot.push_back(0.);
+    }
+    if(amp.size() < 2)
+        return 0;
+    return shower_geometric_reconstruction(amp.size(), amp.data(), ximg.data(), yimg.data(),
+                                           phi.data(), disp.data(), xt.data(), yt.data(), zt.data(),
+                                           taz.data(), talt.data(), flen.data(), rot.data(),
+                                           az, alt, 0, shower_az, shower_alt, NULL, xc, yc, NULL);
+}
@@ -0,0 +1,257 @@
+#include "Hist_defs.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+Hist_def::Hist_def()
+{
+    clear();
+}
+
+void Hist_def::clear()
+{
+    name.clear();
+    title.clear();
+    tree = "event_data";
+    dim = 0;
+    for(int i = 0; i < 3; i++)
+    {
+        expr[i].clear();
+        nbins[i] = 0;
+        lo[i] = hi[i] = 0.;
+    }
+    weight.clear();
+    cut.clear();
+}
+
+Hist_defs::Hist_defs()
+{
+
+}
+
+Hist_defs::~Hist_defs()
+{
+
+}
+
+void Hist_defs::clear()
+{
+    defs.clear();
+}
+
+// Split at blanks, double quotes group (and are removed), '#' outside quotes ends the line
+static int split_words(const std::string& line, std::vector<std::string>& words)
+{
+    std::string w;
+    bool in_word = false, quoted = false;
+    words.clear();
+    for(size_t i = 0; i < line.size(); i++)
+    {
+        char c = line[i];
+        if(quoted)
+        {
+            if(c == '"')
+                quoted = false;
+            else
+                w += c;
+            continue;
+        }
+        if(c == '#')
+            break;
+        if(c == '"')
+        {
+            quoted = in_word = true;
+            continue;
+        }
+        if(c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        {
+            if(in_word)
+                words.push_back(w);
+            w.clear();
+            in_word = false;
+            continue;
+        }
+        w += c;
+        in_word = true;
+    }
+    if(quoted)
+        return -1;
+    if(in_word)
+        words.push_back(w);
+    return 0;
+}
+
+// Returns 0 if ok, 1 for an empty line, -1 on error
+int Hist_defs::parse(const std::string& line, const char* where)
+{
+    std::vector<std::string> words;
+    if(split_words(line, words) != 0)
+    {
+        std::cout << "Unterminated quote in " << where << std::endl;
+        return -1;
+    }
+    if(words.empty())
+        return 1;
+
+    Hist_def d;
+    std::vector<double> bins;
+    d.name = words[0];
+    for(size_t i = 1; i < words.size(); i++)
+    {
+        size_t eq = words[i].find('=');
+        if(eq == std::string::npos || eq == 0)
+        {
+            std::cout << "Expected key=value instead of '" << words[i] << "' in " << where << std::endl;
+            return -1;
+        }
+        std::string key = words[i].substr(0, eq);
+        std::string val = words[i].substr(eq + 1);
+        if(key == "tree")
+            d.tree = val;
+        else if(key == "x")
+            d.expr[0] = val;
+        else if(key == "y")
+            d.expr[1] = val;
+        else if(key == "z")
+            d.expr[2] = val;
+        else if(key == "w")
+            d.weight = val;
+        else if(key == "cut")
+            d.cut = val;
+        else if(key == "title")
+            d.title = val;
+        else if(key == "bins")
+        {
+            const char* s = val.c_str();
+            for(;;)
+            {
+                char* e;
+                double v = strtod(s, &e);
+                if(e == s)
+                    break;
+                bins.push_back(v);
+                s = e;
+                if(*s != ',')
+                    break;
+                s++;
+            }
+            if(*s != '\0')
+            {
+                std::cout << "Bad bins '" << val << "' in " << where << std::endl;
+                return -1;
+            }
+        }
+        else
+        {
+            std::cout << "Unknown key '" << key << "' in " << where << std::endl;
+            return -1;
+        }
+    }
+
+    d.dim = d.expr[2].empty() ? (d.expr[1].empty() ? (d.expr[0].empty() ? 0 : 1) : 2) : 3;
+    if(d.dim == 0 || (d.dim > 1 && d.expr[0].empty()) || (d.dim > 2 && d.expr[1].empty()))
+    {
+        std::cout << "Histogram " << d.name << " needs x (and y before z) in " << where << std::endl;
+        return -1;
+    }
+    if(bins.size() != (size_t) (3 * d.dim))
+    {
+        std::cout << "Histogram " << d.name << " needs " << 3 * d.dim << " bins values in " << where << std::endl;
+        return -1;
+    }
+    for(int i = 0; i < d.dim; i++)
+    {
+        d.nbins[i] = (int) bins[3 * i];
+        d.lo[i] = bins[3 * i + 1];
+        d.hi[i] = bins[3 * i + 2];
+        if(d.nbins[i] < 1 || d.nbins[i] != bins[3 * i] || !(d.hi[i] > d.lo[i]))
+        {
+            std::cout << "Bad binning of histogram " << d.name << " in " << where << std::endl;
+            return -1;
+        }
+    }
+    for(size_t i = 0; i < defs.size(); i++)
+    {
+        if(defs[i].name == d.name)
+        {
+            std::cout << "Histogram " << d.name << " defined twice in " << where << std::endl;
+            return -1;
+        }
+    }
+    if(d.title.empty())
+        d.title = d.name;
+    defs.push_back(d);
+    return 0;
+}
+
+// The lateral photon density histograms h1/h2, used when no definitions are given
+void Hist_defs::set_default()
+{
+    clear();
+    parse("h1 x=rc bins=30,0,600 title=photon_density");
+    parse("h2 x=rc bins=30,0,600 w=photons/area title=density_with_weight");
+}
+
+// Returns 0 if ok, -1 on error
+int Hist_defs::read(const char* fname)
+{
+    FILE* f;
+    char line[10240];
+    int iline = 0;
+
+    if((f = fopen(fname, "r")) == NULL)
+    {
+        perror(fname);
+        return -1;
+    }
+    while(fgets(line, sizeof(line) - 1, f) != NULL)
+    {
+        iline++;
+        std::string where = std::string(fname) + " line " + std::to_string(iline);
+        if(parse(line, where.c_str()) < 0)
+        {
+            fclose(f);
+            return -1;
+        }
+    }
+    fclose(f);
+    if(defs.empty())
+    {
+        std::cout << "No histogram definitions in " << fname << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// Trees used by the definitions, in order of first use
+std::vector<std::string> Hist_defs::trees() const
+{
+    std::vector<std::string> t;
+    for(size_t i = 0; i < defs.size(); i++)
+    {
+        if(std::find(t.begin(), t.end(), defs[i].tree) == t.end())
+            t.push_back(defs[i].tree);
+    }
+    return t;
+}
+
+// All definitions as one text, to recognize histograms filled with the same definitions
+std::string Hist_defs::key() const
+{
+    std::string k;
+    char buf[64];
+    for(size_t i = 0; i < defs.size(); i++)
+    {
+        const Hist_def& d = defs[i];
+        k += d.name + '\x1f' + d.title + '\x1f' + d.tree + '\x1f';
+        for(int j = 0; j < d.dim; j++)
+        {
+            snprintf(buf, sizeof(buf), "%d,%.17g,%.17g", d.nbins[j], d.lo[j], d.hi[j]);
+            k += d.expr[j] + '\x1f' + buf + '\x1f';
+        }
+        k += d.weight + '\x1f' + d.cut + '\n';
+    }
+    return k;
+}
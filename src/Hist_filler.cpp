@@ -0,0 +1,262 @@
+#include "Hist_filler.h"
+#include "TH1D.h"
+#include "TH2D.h"
+#include "TH3D.h"
+#include "TFormula.h"
+#include <cctype>
+#include <iostream>
+
+// variables of the two trees, in the order of the value arrays
+static const char* event_vars[] = {"photons", "itel", "rc", "run_id", "rtel", "zenith", "area", "energy",
+                                    "gen_index", "gen_emin", "gen_emax", "run", NULL};
+static const int n_event_vars = 12;
+static const char* bunch_vars[] = {"bunch_x", "bunch_y", "cx", "cy", "time", "p_height", "lambda", "nbunch",
+                                   "itel", "rc", "trans", "npe", "area", "depth", NULL};
+
+static int find_var(const char* const* vars, const std::string& name)
+{
+    for(int i = 0; vars[i] != NULL; i++)
+    {
+        if(name == vars[i])
+            return i;
+    }
+    return -1;
+}
+
+Hist_filler::Hist_filler()
+{
+    has_bunch_defs = false;
+    last_energy = -1.;
+}
+
+Hist_filler::~Hist_filler()
+{
+    clear();
+}
+
+void Hist_filler::clear()
+{
+    for(size_t i = 0; i < hists.size(); i++)
+        delete hists[i];
+    for(size_t i = 0; i < val.size(); i++)
+        delete val[i].f;
+    defs.clear();
+    hists.clear();
+    tree.clear();
+    val.clear();
+    has_bunch_defs = false;
+    spectra.clear();
+    last_energy = -1.;
+}
+
+// Event variable index, including the weights "w_<name>" after the fixed variables
+int Hist_filler::event_var(const std::string& name) const
+{
+    int k = find_var(event_vars, name);
+    if(k >= 0 || name.compare(0, 2, "w_") != 0)
+        return k;
+    for(size_t i = 0; i < spectra.names.size(); i++)
+    {
+        if(name.compare(2, std::string::npos, spectra.names[i]) == 0)
+            return n_event_vars + i;
+    }
+    return -1;
+}
+
+// Expression to a variable index or a TFormula with the variables as x[i]
+int Hist_filler::set_value(value& v, const std::string& expr, int t, const std::string& name)
+{
+    v.var = -2;
+    v.f = NULL;
+    if(expr.empty())
+        return 0;
+    if((v.var = (t == EVENT_TREE) ? event_var(expr) : find_var(bunch_vars, expr)) >= 0)
+        return 0;
+
+    std::string s;
+    for(size_t i = 0; i < expr.size();)
+    {
+        if(isalpha((unsigned char) expr[i]) || expr[i] == '_')
+        {
+            size_t j = i;
+            while(j < expr.size() && (isalnum((unsigned char) expr[j]) || expr[j] == '_'))
+                j++;
+            std::string id = expr.substr(i, j - i);
+            int k = (t == EVENT_TREE) ? event_var(id) : find_var(bunch_vars, id);
+            // not for members, namespaces or functions
+            bool qualified = (i > 0 && (expr[i - 1] == '.' || expr[i - 1] == ':')) ||
+                             (j < expr.size() && (expr[j] == ':' || expr[j] == '('));
+            if(k >= 0 && !qualified)
+                s += "x[" + std::to_string(k) + "]";
+            else
+                s += id;
+            i = j;
+        }
+        else if(isdigit((unsigned char) expr[i]) || expr[i] == '.')
+        {
+            // numbers, including exponents like 1e5
+            size_t j = i;
+            while(j < expr.size() && (isalnum((unsigned char) expr[j]) || expr[j] == '.'
+                                      || ((expr[j] == '+' || expr[j] == '-') && (expr[j - 1] == 'e' || expr[j - 1] == 'E'))))
+                j++;
+            s += expr.substr(i, j - i);
+            i = j;
+        }
+        else
+        {
+            s += expr[i++];
+        }
+    }
+    v.var = -1;
+    v.f = new TFormula(name.c_str(), s.c_str(), false);
+    if(!v.f->IsValid())
+    {
+        std::cout << "Cannot use the expression '" << expr << "' (" << s << ")" << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// Returns 0 if ok, -1 for definitions of other trees or bad expressions.
+// With sw, its targets are the event variables "w_<name>", as in Draw.
+int Hist_filler::init(const Hist_defs& hd, const Spectral_weights* sw)
+{
+    clear();
+    if(sw != NULL)
+    {
+        spectra = *sw;
+        spectra.set_generation(-1., 0., 0.);
+    }
+    event_val.assign(n_event_vars + spectra.names.size(), 0.);
+    defs = hd.defs;
+    for(size_t i = 0; i < defs.size(); i++)
+    {
+        const Hist_def& d = defs[i];
+        int t;
+        if(d.tree == "event_data")
+            t = EVENT_TREE;
+        else if(d.tree == "bunch")
+            t = BUNCH_TREE;
+        else
+        {
+            std::cout << "Histogram " << d.name << ": only event_data and bunch can be filled during the conversion"
+                      << std::endl;
+            return -1;
+        }
+        tree.push_back(t);
+        has_bunch_defs = has_bunch_defs || (t == BUNCH_TREE);
+        TH1* h;
+        if(d.dim == 1)
+            h = new TH1D(d.name.c_str(), d.title.c_str(), d.nbins[0], d.lo[0], d.hi[0]);
+        else if(d.dim == 2)
+            h = new TH2D(d.name.c_str(), d.title.c_str(), d.nbins[0], d.lo[0], d.hi[0], d.nbins[1], d.lo[1], d.hi[1]);
+        else
+            h = new TH3D(d.name.c_str(), d.title.c_str(), d.nbins[0], d.lo[0], d.hi[0], d.nbins[1], d.lo[1], d.hi[1],
+                         d.nbins[2], d.lo[2], d.hi[2]);
+        h->SetDirectory(0);
+        if(!d.weight.empty())
+            h->Sumw2();
+        hists.push_back(h);
+
+        const std::string* e[5] = {&d.expr[0], &d.expr[1], &d.expr[2], &d.weight, &d.cut};
+        for(int k = 0; k < 5; k++)
+        {
+            val.push_back(value());
+            if(set_value(val.back(), *e[k], t, d.name + "_f" + std::to_string(k)) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+void Hist_filler::fill(int t, const double* v)
+{
+    for(size_t i = 0; i < defs.size(); i++)
+    {
+        if(tree[i] != t)
+            continue;
+        double x[5];
+        for(int k = 0; k < 5; k++)
+        {
+            const value& vk = val[i * 5 + k];
+            x[k] = (vk.var >= 0) ? v[vk.var] : (vk.var == -1) ? vk.f->EvalPar(v) : 1.;
+        }
+        if(x[4] == 0.)
+            continue;
+        if(defs[i].dim == 1)
+            hists[i]->Fill(x[0], x[3]);
+        else if(defs[i].dim == 2)
+            ((TH2D*) hists[i])->Fill(x[0], x[1], x[3]);
+        else
+            ((TH3D*) hists[i])->Fill(x[0], x[1], x[2], x[3]);
+    }
+}
+
+// One event_data entry
+void Hist_filler::fill_event(int run_id, int itel, double photons, double rc, double rtel, double zenith, double area,
+                             double energy, double gen_index, double gen_emin, double gen_emax, int run)
+{
+    double* v = event_val.data();
+    v[0] = photons;
+    v[1] = itel;
+    v[2] = rc;
+    v[3] = run_id;
+    v[4] = rtel;
+    v[5] = zenith;
+    v[6] = area;
+    v[7] = energy;
+    v[8] = gen_index;
+    v[9] = gen_emin;
+    v[10] = gen_emax;
+    v[11] = run;
+    if(!spectra.names.empty())
+    {
+        // all telescopes of a shower share the weights
+        if(gen_index != spectra.gen_index || gen_emin != spectra.e_min || gen_emax != spectra.e_max)
+        {
+            spectra.set_generation(gen_index, gen_emin, gen_emax);
+            last_energy = -1.;
+        }
+        if(energy != last_energy)
+        {
+            spectra.weights(&energy, 1, v + n_event_vars);
+            last_energy = energy;
+        }
+    }
+    fill(EVENT_TREE, v);
+}
+
+// The bunches of one telescope, with the same units as in the bunch tree; trans/npe/depth may be NULL
+void Hist_filler::fill_bunches(const struct bunch* bunches, int nbunches, int itel, double rc, double area,
+                               const float* trans, const float* npe, const double* depth)
+{
+    if(!has_bunch_defs)
+        return;
+    double v[14];
+    v[8] = itel;
+    v[9] = rc;
+    v[12] = area;
+    for(int i = 0; i < nbunches; i++)
+    {
+        const struct bunch& b = bunches[i];
+        v[0] = b.x * 0.01;
+        v[1] = b.y * 0.01;
+        v[2] = b.cx;
+        v[3] = b.cy;
+        v[4] = b.ctime;
+        v[5] = b.zem;
+        v[6] = b.lambda;
+        v[7] = b.photons;
+        v[10] = (trans != NULL) ? trans[i] : 1.;
+        v[11] = (npe != NULL) ? npe[i] : -1.;
+        v[13] = (depth != NULL) ? depth[i] : -1.;
+        fill(BUNCH_TREE, v);
+    }
+}
+
+// To the current directory
+void Hist_filler::write()
+{
+    for(size_t i = 0; i < hists.size(); i++)
+        hists[i]->Write();
+}
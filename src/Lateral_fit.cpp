@@ -0,0 +1,240 @@
+#include "Lateral_fit.h"
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include "Minuit2/FCNGradientBase.h"
+#include "Minuit2/MnUserParameters.h"
+#include "Minuit2/MnMigrad.h"
+#include "Minuit2/FunctionMinimum.h"
+#include "ROOT/TThreadExecutor.hxx"
+#include "ROOT/TSeq.hxx"
+
+// Minuit2 interface to Lateral_fit::nll for the points of one shower
+class Lateral_fcn : public ROOT::Minuit2::FCNGradientBase
+{
+    public:
+    const double *r, *lr, *n, *la;
+    size_t np;
+
+    Lateral_fcn(const double* r_, const double* lr_, const double* n_, const double* la_, size_t np_)
+    {
+        r = r_;
+        lr = lr_;
+        n = n_;
+        la = la_;
+        np = np_;
+    }
+    double operator()(const std::vector<double>& p) const
+    {
+        return Lateral_fit::nll(p.data(), r, lr, n, la, np, NULL);
+    }
+    std::vector<double> Gradient(const std::vector<double>& p) const
+    {
+        std::vector<double> g(3);
+        Lateral_fit::nll(p.data(), r, lr, n, la, np, g.data());
+        return g;
+    }
+    double Up() const
+    {
+        return 0.5;
+    }
+    bool CheckGradient() const
+    {
+        return false;
+    }
+};
+
+Lateral_fit::Lateral_fit()
+{
+    clear();
+}
+
+Lateral_fit::~Lateral_fit()
+{
+
+}
+
+void Lateral_fit::clear()
+{
+    run.clear();
+    run_id.clear();
+    r.clear();
+    lr.clear();
+    n.clear();
+    la.clear();
+    first.clear();
+    results.clear();
+    min_points = 4;
+    chunk = 32;
+}
+
+// Points in any order, one per telescope and shower (event_data entries)
+void Lateral_fit::set_points(const std::vector<int>& runs, const std::vector<int>& id, const std::vector<double>& rc,
+                             const std::vector<double>& photons, const std::vector<double>& area)
+{
+    size_t np = id.size();
+    std::vector<size_t> idx(np);
+    std::iota(idx.begin(), idx.end(), (size_t) 0);
+    std::stable_sort(idx.begin(), idx.end(), [&runs, &id](size_t a, size_t b)
+                     { return runs[a] < runs[b] || (runs[a] == runs[b] && id[a] < id[b]); });
+
+    run.resize(np);
+    run_id.resize(np);
+    r.resize(np);
+    lr.resize(np);
+    n.resize(np);
+    la.resize(np);
+    first.clear();
+    for(size_t i = 0; i < np; i++)
+    {
+        size_t j = idx[i];
+        if(i == 0 || id[j] != run_id[i - 1] || runs[j] != run[i - 1])
+            first.push_back(i);
+        run[i] = runs[j];
+        run_id[i] = id[j];
+        r[i] = std::max(rc[j], 1.);
+        lr[i] = log(r[i]);
+        n[i] = photons[j];
+        la[i] = log(area[j]);
+    }
+    first.push_back(np);
+    results.clear();
+}
+
+// Negative log-likelihood (without the constant terms of the photons) and its
+// gradient if grad != NULL. One pass over contiguous arrays, no branches in the loop.
+double Lateral_fit::nll(const double* par, const double* r, const double* lr, const double* n,
+                        const double* la, size_t np, double* grad)
+{
+    double lnA = par[0];
+    double a = par[1] - 2.;
+    double b = par[1] - 4.5;
+    double ir0 = 1. / par[2];
+    double lr0 = log(par[2]);
+    double f = 0., g0 = 0., g1 = 0., g2 = 0.;
+    for(size_t i = 0; i < np; i++)
+    {
+        double u = r[i] * ir0;
+        double l1 = log1p(u);
+        double lx = lr[i] - lr0;
+        double lm = lnA + a * lx + b * l1 + la[i];
+        double mu = exp(lm);
+        double d = mu - n[i];
+        f += mu - n[i] * lm;
+        g0 += d;
+        g1 += d * (lx + l1);
+        g2 += d * u / (1. + u);
+    }
+    if(grad != NULL)
+    {
+        grad[0] = g0;
+        grad[1] = g1;
+        grad[2] = -(a * g0 + b * g2) * ir0;
+    }
+    return f;
+}
+
+// Fit of shower k, from start (lnA unused, it is computed from the photon sum) or the defaults
+void Lateral_fit::fit(size_t k, const double* start, result& res) const
+{
+    size_t i0 = first[k];
+    size_t np = first[k + 1] - i0;
+    double sum = 0., c = 0.;
+    int npos = 0;
+    for(size_t i = i0; i < i0 + np; i++)
+    {
+        sum += n[i];
+        if(n[i] > 0.)
+        {
+            npos++;
+            c += n[i] * log(n[i]) - n[i];
+        }
+    }
+    res.run = run[i0];
+    res.run_id = run_id[i0];
+    res.npoints = np;
+    res.photons = sum;
+    res.nll = res.edm = 0.;
+    res.nfcn = 0;
+    for(int j = 0; j < 3; j++)
+        res.par[j] = res.err[j] = 0.;
+    if(npos < min_points)
+    {
+        res.status = -1;
+        return;
+    }
+
+    // normalization matching the photon sum for the starting shape
+    double p[3] = {0., start ? start[1] : 1., start ? start[2] : 80.};
+    double g[3];
+    nll(p, &r[i0], &lr[i0], &n[i0], &la[i0], np, g);
+    p[0] = log(sum / (g[0] + sum));
+
+    Lateral_fcn fcn(&r[i0], &lr[i0], &n[i0], &la[i0], np);
+    ROOT::Minuit2::MnUserParameters up;
+    up.Add("lnA", p[0], 0.1);
+    up.Add("s", p[1], 0.1);
+    up.SetLimits("s", 0.05, 4.);
+    up.Add("r0", p[2], 0.2 * p[2]);
+    up.SetLimits("r0", 1., 2000.);
+    ROOT::Minuit2::MnMigrad migrad(fcn, up);
+    ROOT::Minuit2::FunctionMinimum m = migrad(1000);
+
+    res.status = m.IsValid() ? 0 : 1;
+    for(int j = 0; j < 3; j++)
+    {
+        res.par[j] = m.UserState().Value(j);
+        res.err[j] = m.UserState().Error(j);
+    }
+    // relative to the saturated model
+    res.nll = m.Fval() + c;
+    res.edm = m.Edm();
+    res.nfcn = m.NFcn();
+}
+
+// All showers, on nthreads threads (0: all cores, 1: no thread pool)
+void Lateral_fit::fit_all(int nthreads)
+{
+    size_t ns = first.empty() ? 0 : first.size() - 1;
+    results.assign(ns, result());
+    if(ns == 0)
+        return;
+
+    // similar showers next to each other, so that each fit starts close to its minimum
+    std::vector<double> sum(ns, 0.);
+    for(size_t k = 0; k < ns; k++)
+    {
+        for(size_t i = first[k]; i < first[k + 1]; i++)
+            sum[k] += n[i];
+    }
+    std::vector<size_t> order(ns);
+    std::iota(order.begin(), order.end(), (size_t) 0);
+    std::sort(order.begin(), order.end(), [&sum](size_t a, size_t b) { return sum[a] < sum[b]; });
+
+    unsigned nchunk = (ns + chunk - 1) / chunk;
+    auto work = [&](unsigned ic)
+    {
+        const double* start = NULL;
+        double prev[3];
+        for(size_t j = ic * chunk; j < std::min(ns, (ic + 1) * chunk); j++)
+        {
+            result& res = results[order[j]];
+            fit(order[j], start, res);
+            if(res.status == 0)
+            {
+                std::copy(res.par, res.par + 3, prev);
+                start = prev;
+            }
+        }
+    };
+    if(nthreads == 1)
+    {
+        for(unsigned ic = 0; ic < nchunk; ic++)
+            work(ic);
+    }
+    else
+    {
+        ROOT::TThreadExecutor pool(nthreads > 0 ? nthreads : 0);
+        pool.Foreach(work, ROOT::TSeq<unsigned>(nchunk));
+    }
+}
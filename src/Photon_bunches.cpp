@@ -8,6 +8,9 @@ Photon_bunches::Photon_bunches()
     nbunch = 0.;
     itel = -1;
     rc = -1;
+    trans = 1.;
+    npe = -1.;
+    depth = -1.;
 }
 
 void Photon_bunches::clear()
@@ -18,6 +21,9 @@ void Photon_bunches::clear()
     nbunch = 0.; 
     itel = -1;
     rc = -1;
+    trans = 1.;
+    npe = -1.;
+    depth = -1.;
 }
 
 void Photon_bunches::fill_photon_bunch(struct bunch bunches, int array_id, int tel_id, double r)
@@ -0,0 +1,186 @@
+#include "Qe_ref.h"
+#include "fileopen.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+Qe_ref::Qe_ref()
+{
+    clear();
+}
+
+Qe_ref::~Qe_ref()
+{
+
+}
+
+void Qe_ref::clear()
+{
+    max_lambda = 1000;
+    eff.assign(max_lambda, 1.f);
+    lambda_min = 250.;
+    lambda_max = 700.;
+    seed = 12345;
+}
+
+// Wavelength [nm] and value from the first two columns, '#' starts a comment.
+// Returns 0 if ok, -1 on error
+int Qe_ref::read_table(const char* fname, std::vector<double>& wl, std::vector<double>& val)
+{
+    FILE* f;
+    char line[1024];
+
+    wl.clear();
+    val.clear();
+    if((f = fileopen(fname, "r")) == NULL)
+    {
+        perror(fname);
+        return -1;
+    }
+    while(fgets(line, sizeof(line) - 1, f) != NULL)
+    {
+        char* c = strchr(line, '#');
+        if(c != NULL)
+            *c = '\0';
+        char* s = line;
+        char* e;
+        double x = strtod(s, &e);
+        if(e == s)
+            continue;
+        s = e;
+        double y = strtod(s, &e);
+        if(e == s)
+            continue;
+        if(!wl.empty() && x <= wl.back())
+        {
+            std::cout << "Wavelengths not increasing in " << fname << std::endl;
+            fileclose(f);
+            return -1;
+        }
+        wl.push_back(x);
+        val.push_back(y);
+    }
+    fileclose(f);
+    if(wl.size() < 2)
+    {
+        std::cout << "No usable table in " << fname << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+// linear interpolation, zero outside the table as in absorb.c
+static double interp_table(const std::vector<double>& x, const std::vector<double>& y, double v)
+{
+    if(v < x.front() || v > x.back())
+        return 0.;
+    size_t i = std::upper_bound(x.begin(), x.end(), v) - x.begin();
+    if(i >= x.size())
+        return y.back();
+    return y[i - 1] + (v - x[i - 1]) / (x[i] - x[i - 1]) * (y[i] - y[i - 1]);
+}
+
+// Any of the files may be NULL or "none" for efficiency 1.
+// Returns 0 if ok, -1 on error
+int Qe_ref::read(const char* qe_fname, const char* ref_fname, const char* ref2_fname)
+{
+    const char* fnames[3] = {qe_fname, ref_fname, ref2_fname};
+    std::vector<double> wl, val;
+
+    eff.assign(max_lambda, 1.f);
+    for(int k = 0; k < 3; k++)
+    {
+        if(fnames[k] == NULL || strcmp(fnames[k], "none") == 0)
+            continue;
+        if(read_table(fnames[k], wl, val) != 0)
+        {
+            eff.assign(max_lambda, 1.f);
+            return -1;
+        }
+        for(int il = 0; il < max_lambda; il++)
+            eff[il] *= interp_table(wl, val, il);
+    }
+    return 0;
+}
+
+void Qe_ref::set_bandwidth(double lmin, double lmax)
+{
+    if(lmin > 0. && lmax > lmin)
+    {
+        lambda_min = lmin;
+        lambda_max = lmax;
+    }
+}
+
+static inline double lookup(const float* eff, int n, double lambda)
+{
+    double u = std::min(std::max(lambda, 0.), (double) (n - 1));
+    int i = std::min((int) u, n - 2);
+    double f = u - i;
+    return eff[i] + f * (eff[i + 1] - eff[i]);
+}
+
+double Qe_ref::efficiency(double lambda) const
+{
+    return lookup(eff.data(), max_lambda, lambda);
+}
+
+static inline uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// n uniform numbers in [0,1), the i-th one only depends on seed, key and i
+void Qe_ref::uniform(uint64_t seed, uint64_t key, size_t n, double* u)
+{
+    uint64_t base = splitmix64(seed ^ splitmix64(key));
+    for(size_t i = 0; i < n; i++)
+        u[i] = (splitmix64(base + i) >> 11) * (1. / 9007199254740992.);
+}
+
+// Efficiency for each bunch. key should identify the telescope and event
+// (e.g. event_id*1000+itel) to make the sampled wavelengths reproducible.
+void Qe_ref::efficiency(const struct bunch* bunches, int nbunches, uint64_t key, float* out) const
+{
+    std::vector<double> u(nbunches);
+    uniform(seed, key, nbunches, u.data());
+    // inverse of the lambda^-2 distribution: 1/lambda uniform
+    double a = 1. / lambda_min;
+    double b = 1. / lambda_min - 1. / lambda_max;
+    const float* e = eff.data();
+    int n = max_lambda;
+    for(int i = 0; i < nbunches; i++)
+    {
+        double lsample = 1. / (a - u[i] * b);
+        double lambda = (bunches[i].lambda > 0.f) ? bunches[i].lambda : lsample;
+        out[i] = lookup(e, n, lambda);
+    }
+}
+
+// Expected photo-electrons of each bunch (photons x efficiency [x transmission])
+// into npe (may be NULL), returns their sum.
+double Qe_ref::expected_pe(const struct bunch* bunches, int nbunches, uint64_t key, const float* trans, float* npe) const
+{
+    std::vector<float> tmp;
+    float* w = npe;
+    double sum = 0.;
+    if(w == NULL)
+    {
+        tmp.resize(nbunches);
+        w = tmp.data();
+    }
+    efficiency(bunches, nbunches, key, w);
+    for(int i = 0; i < nbunches; i++)
+    {
+        double t = (trans != NULL) ? trans[i] : 1.;
+        w[i] = bunches[i].photons * w[i] * t;
+        sum += w[i];
+    }
+    return sum;
+}
@@ -0,0 +1,171 @@
+#include "Spectral_weights.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+Spectral_weights::Spectral_weights()
+{
+    clear();
+}
+
+Spectral_weights::~Spectral_weights()
+{
+
+}
+
+void Spectral_weights::clear()
+{
+    gen_index = e_min = e_max = 0.;
+    names.clear();
+    index.clear();
+    beta.clear();
+    e0.clear();
+    c0.clear();
+    c1.clear();
+    c2.clear();
+}
+
+// Returns 0 if ok, -1 for a bad spectrum or a name used twice
+int Spectral_weights::add_target(const std::string& name, double idx, double b, double e_ref)
+{
+    if(name.empty() || !(e_ref > 0.))
+    {
+        std::cout << "Bad target spectrum '" << name << "'" << std::endl;
+        return -1;
+    }
+    for(size_t k = 0; k < names.size(); k++)
+    {
+        if(names[k] == name)
+        {
+            std::cout << "Target spectrum " << name << " given twice" << std::endl;
+            return -1;
+        }
+    }
+    names.push_back(name);
+    index.push_back(idx);
+    beta.push_back(b);
+    e0.push_back(e_ref);
+    c0.push_back(0.);
+    c1.push_back(0.);
+    c2.push_back(0.);
+    if(e_max > e_min)
+        set_generation(gen_index, e_min, e_max);
+    return 0;
+}
+
+// "name:index[:beta[:e0]]", e.g. "crab:-2.47:0.24:1000"
+int Spectral_weights::add_target(const char* spec)
+{
+    const char* c = strchr(spec, ':');
+    if(c == NULL)
+    {
+        std::cout << "Expected name:index[:beta[:e0]] instead of '" << spec << "'" << std::endl;
+        return -1;
+    }
+    double v[3] = {0., 0., 1000.};
+    int nv = 0;
+    const char* s = c + 1;
+    while(nv < 3)
+    {
+        char* e;
+        v[nv] = strtod(s, &e);
+        if(e == s)
+            break;
+        nv++;
+        s = e;
+        if(*s != ':')
+            break;
+        s++;
+    }
+    if(nv == 0 || *s != '\0')
+    {
+        std::cout << "Expected name:index[:beta[:e0]] instead of '" << spec << "'" << std::endl;
+        return -1;
+    }
+    return add_target(std::string(spec, c - spec), v[0], v[1], v[2]);
+}
+
+// ln of the integral of exp(a*L + b*L^2) dE over [lo, hi], with L = ln(E)
+static double log_integral(double a, double b, double lo, double hi)
+{
+    double l1 = log(lo), l2 = log(hi);
+    if(b == 0.)
+    {
+        double a1 = a + 1.;
+        if(fabs(a1 * (l2 - l1)) < 1e-8)
+            return log(l2 - l1) + a1 * l1;
+        // log((hi^a1 - lo^a1) / a1), evaluated without overflow
+        double big = (a1 > 0.) ? l2 : l1;
+        return a1 * big + log(fabs(expm1(-fabs(a1) * (l2 - l1))) / fabs(a1));
+    }
+    // Simpson in L, dE = E dL, relative to the maximum of the integrand
+    const int n = 2000;
+    double h = (l2 - l1) / n;
+    double fmax = -HUGE_VAL;
+    for(int i = 0; i <= n; i++)
+    {
+        double L = l1 + i * h;
+        fmax = std::max(fmax, (a + 1.) * L + b * L * L);
+    }
+    double sum = 0.;
+    for(int i = 0; i <= n; i++)
+    {
+        double L = l1 + i * h;
+        double f = exp((a + 1.) * L + b * L * L - fmax);
+        sum += f * ((i == 0 || i == n) ? 1. : (i % 2) ? 4. : 2.);
+    }
+    return fmax + log(sum * h / 3.);
+}
+
+// Generation spectrum E^idx in [lo, hi] GeV (CORSIKA RUNH words 16-18)
+void Spectral_weights::set_generation(double idx, double lo, double hi)
+{
+    gen_index = idx;
+    e_min = lo;
+    e_max = hi;
+    if(!(hi > lo && lo > 0.))
+        return;
+    double ln_gen = log_integral(idx, 0., lo, hi);
+    for(size_t k = 0; k < names.size(); k++)
+    {
+        // (E/e0)^(index - beta*ln(E/e0)) = exp(a + b*L + c*L^2) with L = ln(E)
+        double l0 = log(e0[k]);
+        double a = -index[k] * l0 - beta[k] * l0 * l0;
+        double b = index[k] + 2. * beta[k] * l0;
+        double c = -beta[k];
+        double ln_t = a + log_integral(b, c, lo, hi);
+        c0[k] = a - ln_t + ln_gen;
+        c1[k] = b - idx;
+        c2[k] = c;
+    }
+}
+
+// Weights of all targets for n energies [GeV]: w[k * n + i]
+void Spectral_weights::weights(const double* energy, size_t n, double* w) const
+{
+    std::vector<double> l(n);
+    std::vector<double> in(n);
+    for(size_t i = 0; i < n; i++)
+    {
+        double e = energy[i];
+        in[i] = (e >= e_min && e <= e_max) ? 1. : 0.;
+        l[i] = log(e > 0. ? e : 1.);
+    }
+    for(size_t k = 0; k < names.size(); k++)
+    {
+        double a = c0[k], b = c1[k], c = c2[k];
+        double* wk = w + k * n;
+        for(size_t i = 0; i < n; i++)
+            wk[i] = in[i] * exp(a + l[i] * (b + c * l[i]));
+    }
+}
+
+double Spectral_weights::weight(size_t k, double energy) const
+{
+    if(!(energy >= e_min && energy <= e_max))
+        return 0.;
+    double l = log(energy);
+    return exp(c0[k] + l * (c1[k] + c2[k] * l));
+}
@@ -0,0 +1,145 @@
+#include "Tdigest.h"
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+Tdigest::Tdigest(double c)
+{
+    compression = c;
+    clear();
+}
+
+Tdigest::~Tdigest()
+{
+
+}
+
+void Tdigest::clear()
+{
+    mean.clear();
+    weight.clear();
+    buf_x.clear();
+    buf_w.clear();
+    total = 0.;
+    min = std::numeric_limits<double>::infinity();
+    max = -std::numeric_limits<double>::infinity();
+}
+
+void Tdigest::add(double x, double w)
+{
+    if(!(w > 0.) || std::isnan(x))
+        return;
+    if(buf_x.capacity() == 0)
+    {
+        buf_x.reserve(4 * (size_t) compression);
+        buf_w.reserve(4 * (size_t) compression);
+    }
+    buf_x.push_back(x);
+    buf_w.push_back(w);
+    total += w;
+    min = std::min(min, x);
+    max = std::max(max, x);
+    if(buf_x.size() >= 4 * (size_t) compression)
+        compress();
+}
+
+// Centroids of another digest (e.g. read back from a file) with its value range
+void Tdigest::add_centroids(const double* m, const double* w, size_t n, double lo, double hi)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        if(!(w[i] > 0.))
+            continue;
+        buf_x.push_back(m[i]);
+        buf_w.push_back(w[i]);
+        total += w[i];
+    }
+    if(n > 0)
+    {
+        min = std::min(min, lo);
+        max = std::max(max, hi);
+    }
+    if(buf_x.size() >= 4 * (size_t) compression)
+        compress();
+}
+
+void Tdigest::merge(const Tdigest& o)
+{
+    add_centroids(o.mean.data(), o.weight.data(), o.mean.size(), o.min, o.max);
+    add_centroids(o.buf_x.data(), o.buf_w.data(), o.buf_x.size(), o.min, o.max);
+}
+
+// Merges the buffer into the centroids: a centroid may grow while it spans at
+// most one unit of k(q) = compression/(2 pi) * asin(2q - 1)
+void Tdigest::compress()
+{
+    if(buf_x.empty())
+        return;
+    size_t n = mean.size() + buf_x.size();
+    std::vector<double> x(n), w(n);
+    std::copy(mean.begin(), mean.end(), x.begin());
+    std::copy(buf_x.begin(), buf_x.end(), x.begin() + mean.size());
+    std::copy(weight.begin(), weight.end(), w.begin());
+    std::copy(buf_w.begin(), buf_w.end(), w.begin() + weight.size());
+    buf_x.clear();
+    buf_w.clear();
+
+    std::vector<size_t> idx(n);
+    std::iota(idx.begin(), idx.end(), (size_t) 0);
+    std::sort(idx.begin(), idx.end(), [&x](size_t a, size_t b) { return x[a] < x[b]; });
+
+    double norm = compression / (2. * M_PI);
+    mean.clear();
+    weight.clear();
+    double cum = 0.;                    // weight before the current centroid
+    double cx = x[idx[0]], cw = w[idx[0]];
+    double q_limit = (sin(std::min((norm * asin(-1.) + 1.) / norm, M_PI / 2.)) + 1.) / 2.;
+    for(size_t i = 1; i < n; i++)
+    {
+        size_t j = idx[i];
+        if((cum + cw + w[j]) / total <= q_limit)
+        {
+            // weighted running mean
+            cw += w[j];
+            cx += (x[j] - cx) * w[j] / cw;
+        }
+        else
+        {
+            mean.push_back(cx);
+            weight.push_back(cw);
+            cum += cw;
+            double k = norm * asin(std::min(2. * cum / total - 1., 1.));
+            q_limit = (sin(std::min((k + 1.) / norm, M_PI / 2.)) + 1.) / 2.;
+            cx = x[j];
+            cw = w[j];
+        }
+    }
+    mean.push_back(cx);
+    weight.push_back(cw);
+}
+
+// Quantile q in [0,1], interpolated between the centroid means (and min/max at the ends)
+double Tdigest::quantile(double q)
+{
+    compress();
+    size_t n = mean.size();
+    if(n == 0)
+        return std::numeric_limits<double>::quiet_NaN();
+    if(n == 1)
+        return mean[0];
+    q = std::min(std::max(q, 0.), 1.);
+    double index = q * total;
+    if(index < weight[0] / 2.)
+        return min + (mean[0] - min) * index / (weight[0] / 2.);
+    double cum = weight[0] / 2.;
+    for(size_t i = 0; i + 1 < n; i++)
+    {
+        double dw = (weight[i] + weight[i + 1]) / 2.;
+        if(cum + dw > index)
+            return mean[i] + (mean[i + 1] - mean[i]) * (index - cum) / dw;
+        cum += dw;
+    }
+    double z = std::min(index - cum, weight[n - 1] / 2.);
+    return mean[n - 1] + (max - mean[n - 1]) * z / (weight[n - 1] / 2.);
+}
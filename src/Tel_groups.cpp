@@ -2,7 +2,8 @@
 #include "rec_tools.h"
 #include <iostream>
 
-void Tel_groups::set()
+// telescope positions to m, once per run (after reading IO_TYPE_MC_TELPOS)
+void Tel_groups::set_tel_pos()
 {
     for(int i = 0 ; i < ntel; i++)
     {
@@ -11,6 +12,10 @@ void Tel_groups::set()
         ztel[i] = ztel[i] * 0.01;
 
     }
+}
+
+void Tel_groups::set()
+{
     for( int k = 0; k < narray; k++)
     {
         xoff[k] = -0.01 * xoff[k];
@@ -29,12 +34,14 @@ Tel_groups::Tel_groups()
 
 void Tel_groups::compute_dist()
 {
+    // third row of the shower transformation matrix is the shower direction
+    const PointingTrans* pt = get_pointing_trans(az, alt);
     for(int i = 0; i< narray; i++)
     {
         for(int j = 0; j < ntel; j++)
         {
-            dist[i * narray + j] = line_point_distance(xoff[i], yoff[i], 0, cos(alt)*cos(az),
-                                                        -cos(alt) * sin(az), sin(alt), xtel[j], ytel[j], ztel[j]);
+            dist[i * narray + j] = line_point_distance(xoff[i], yoff[i], 0, pt->trans[2][0],
+                                                        pt->trans[2][1], pt->trans[2][2], xtel[j], ytel[j], ztel[j]);
         }
     }
 }
@@ -0,0 +1,208 @@
+/* ================================================================ */
+/** @file bench_fast_trig.c
+ *  @short Accuracy and speed of fast_trig.h against libm.
+ *
+ *  Arguments are drawn from the distributions met in the
+ *  reconstruction: azimuth over the full circle, altitude above
+ *  50 degrees, camera offsets within +-5 degrees, image axis angles
+ *  over [-pi,pi] and cosines of small opening angles.
+ *
+ *  Usage: Bench_trig [n]
+ */
+/* ================================================================ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "fast_trig.h"
+#include "rec_tools.h"
+
+static double now (void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static double uniform (double a, double b)
+{
+   return a + (b-a) * (rand() / (RAND_MAX + 1.0));
+}
+
+static double max_abs_diff (const double *a, const double *b, size_t n)
+{
+   double m = 0.;
+   size_t i;
+   for ( i=0; i<n; i++ )
+      if ( fabs(a[i]-b[i]) > m )
+         m = fabs(a[i]-b[i]);
+   return m;
+}
+
+static void report (const char *name, double t_libm, double t_fast, size_t n, double err)
+{
+   printf("%-18s libm %7.2f ns   fast %7.2f ns   speed-up %5.2f   max. abs. error %.3g\n",
+      name, 1e9*t_libm/n, 1e9*t_fast/n, t_libm/t_fast, err);
+}
+
+int main (int argc, char **argv)
+{
+   size_t n = (argc > 1) ? (size_t) atol(argv[1]) : 10000000;
+   double *x = (double *) calloc(n, sizeof(double));
+   double *y = (double *) calloc(n, sizeof(double));
+   double *r1 = (double *) calloc(n, sizeof(double));
+   double *r2 = (double *) calloc(n, sizeof(double));
+   double *r3 = (double *) calloc(n, sizeof(double));
+   double *r4 = (double *) calloc(n, sizeof(double));
+   double t0, t1, t2, e;
+   size_t i;
+
+   if ( x == NULL || y == NULL || r1 == NULL || r2 == NULL || r3 == NULL || r4 == NULL )
+   {
+      fprintf(stderr, "Not enough memory for %zu samples.\n", n);
+      return 1;
+   }
+   for ( i=0; i<n; i++ ) /* Touch all pages before timing */
+      x[i] = y[i] = r1[i] = r2[i] = r3[i] = r4[i] = 0.;
+   srand(12345);
+
+   /* sin/cos of azimuth, altitude and image axis angles */
+   for ( i=0; i<n; i++ )
+   {
+      switch ( i % 3 )
+      {
+         case 0: x[i] = uniform(0., 2.*M_PI); break;
+         case 1: x[i] = uniform(50.*M_PI/180., 0.5*M_PI); break;
+         default: x[i] = uniform(-M_PI, M_PI); break;
+      }
+   }
+   t0 = now();
+   for ( i=0; i<n; i++ )
+   {
+      r1[i] = sin(x[i]);
+      r2[i] = cos(x[i]);
+   }
+   t1 = now();
+   fast_sincos_v(x, r3, r4, n);
+   t2 = now();
+   e = max_abs_diff(r1, r3, n);
+   if ( max_abs_diff(r2, r4, n) > e )
+      e = max_abs_diff(r2, r4, n);
+   report("sincos", t1-t0, t2-t1, n, e);
+
+   /* Large arguments, to check the range reduction */
+   for ( i=0; i<n; i++ )
+      x[i] = uniform(-1e5, 1e5);
+   for ( i=0; i<n; i++ )
+   {
+      r1[i] = sin(x[i]);
+      r2[i] = cos(x[i]);
+   }
+   fast_sincos_v(x, r3, r4, n);
+   e = max_abs_diff(r1, r3, n);
+   if ( max_abs_diff(r2, r4, n) > e )
+      e = max_abs_diff(r2, r4, n);
+   printf("%-18s max. abs. error %.3g\n", "sincos |x|<1e5", e);
+
+   /* atan2 of camera offsets and direction components */
+   for ( i=0; i<n; i++ )
+   {
+      if ( i % 2 )
+      {
+         x[i] = uniform(-0.09, 0.09);
+         y[i] = uniform(-0.09, 0.09);
+      }
+      else
+      {
+         x[i] = uniform(-1., 1.);
+         y[i] = uniform(-1., 1.);
+      }
+   }
+   t0 = now();
+   for ( i=0; i<n; i++ )
+      r1[i] = atan2(y[i], x[i]);
+   t1 = now();
+   fast_atan2_v(y, x, r2, n);
+   t2 = now();
+   report("atan2", t1-t0, t2-t1, n, max_abs_diff(r1, r2, n));
+
+   /* asin of the height component of directions above 50 deg altitude */
+   for ( i=0; i<n; i++ )
+      x[i] = sin(uniform(50.*M_PI/180., 0.5*M_PI));
+   t0 = now();
+   for ( i=0; i<n; i++ )
+      r1[i] = asin(x[i]);
+   t1 = now();
+   for ( i=0; i<n; i++ )
+      r2[i] = fast_asin(x[i]);
+   t2 = now();
+   report("asin", t1-t0, t2-t1, n, max_abs_diff(r1, r2, n));
+
+   /* acos of cosines of opening angles between 0.01 and 90 deg */
+   for ( i=0; i<n; i++ )
+      x[i] = cos(uniform(1e-2, 90.) * (M_PI/180.));
+   t0 = now();
+   for ( i=0; i<n; i++ )
+      r1[i] = acos(x[i]);
+   t1 = now();
+   for ( i=0; i<n; i++ )
+      r2[i] = fast_acos(x[i]);
+   t2 = now();
+   report("acos", t1-t0, t2-t1, n, max_abs_diff(r1, r2, n));
+
+   /* The rec_tools functions with either backend */
+   for ( i=0; i<n; i++ )
+   {
+      x[i] = uniform(0., 2.*M_PI);
+      y[i] = uniform(50.*M_PI/180., 0.5*M_PI);
+   }
+   rec_set_fast_trig(0);
+   t0 = now();
+   for ( i=0; i+1<n; i++ )
+      r1[i] = angle_between(x[i], y[i], x[i+1], y[i+1]);
+   t1 = now();
+   rec_set_fast_trig(1);
+   for ( i=0; i+1<n; i++ )
+      r2[i] = angle_between(x[i], y[i], x[i+1], y[i+1]);
+   t2 = now();
+   report("angle_between", t1-t0, t2-t1, n-1, max_abs_diff(r1, r2, n-1));
+
+   rec_set_fast_trig(0);
+   t0 = now();
+   for ( i=0; i+1<n; i++ )
+      offset_to_angles(0.05*cos(x[i]), 0.05*sin(x[i]), x[i+1], y[i+1], 1.,
+         &r1[i], &r3[i]);
+   t1 = now();
+   rec_set_fast_trig(1);
+   for ( i=0; i+1<n; i++ )
+      offset_to_angles(0.05*cos(x[i]), 0.05*sin(x[i]), x[i+1], y[i+1], 1.,
+         &r2[i], &r4[i]);
+   t2 = now();
+   e = max_abs_diff(r1, r2, n-1);
+   if ( max_abs_diff(r3, r4, n-1) > e )
+      e = max_abs_diff(r3, r4, n-1);
+   report("offset_to_angles", t1-t0, t2-t1, n-1, e);
+
+   rec_set_fast_trig(0);
+   t0 = now();
+   for ( i=0; i+1<n; i++ )
+      r1[i] = compute_true_dsp(x[i], y[i], 100.*cos(x[i+1]), 100.*sin(x[i+1]),
+         50., -30., 0., 70.*M_PI/180.);
+   t1 = now();
+   rec_set_fast_trig(1);
+   for ( i=0; i+1<n; i++ )
+      r2[i] = compute_true_dsp(x[i], y[i], 100.*cos(x[i+1]), 100.*sin(x[i+1]),
+         50., -30., 0., 70.*M_PI/180.);
+   t2 = now();
+   report("compute_true_dsp", t1-t0, t2-t1, n-1, max_abs_diff(r1, r2, n-1));
+
+   free(x);
+   free(y);
+   free(r1);
+   free(r2);
+   free(r3);
+   free(r4);
+   return 0;
+}
@@ -0,0 +1,163 @@
+/* ================================================================ */
+/** @file bench_rpolator.c
+ *  @short Speed and accuracy of single-precision compact rpolator
+ *         tables (rpol_compact) against the double tables.
+ *
+ *  Values are looked up at random positions, as for photons hitting
+ *  a funnel or transmission table, in 1-D and 2-D tables small enough
+ *  to stay in L1/L2 and large enough to overflow it. The error is the
+ *  largest deviation from the double result relative to the largest
+ *  table value.
+ *
+ *  Usage: Bench_rpol [n]
+ */
+/* ================================================================ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "rpolator.h"
+
+static double now (void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+static double uniform (double a, double b)
+{
+   return a + (b-a) * (rand() / (RAND_MAX + 1.0));
+}
+
+/* A 1-D or 2-D table for local use, set up like simple_rpol1d_table() */
+static struct rpol_table *make_table (const char *label, size_t nx, size_t ny, int xlogspaced, int ylogspaced)
+{
+   struct rpol_table *rpt = (struct rpol_table *) calloc(1,sizeof(struct rpol_table));
+   size_t i, j;
+
+   rpt->ndim = (ny > 0) ? 2 : 1;
+   rpt->nx = nx;
+   rpt->ny = ny;
+   rpt->x = (double *) calloc(nx,sizeof(double));
+   rpt->y = ny ? (double *) calloc(ny,sizeof(double)) : NULL;
+   rpt->z = (double *) calloc(ny ? nx*ny : nx,sizeof(double));
+   for ( i=0; i<nx; i++ )
+      rpt->x[i] = xlogspaced ? 1e3*(exp(5.*i/(nx-1.))-1.) : 1e3*i/(nx-1.);
+   for ( j=0; j<ny; j++ )
+      rpt->y[j] = ylogspaced ? exp(3.*j/(ny-1.))-1. : 3.*j/(ny-1.);
+   for ( i=0; i<nx; i++ )
+   {
+      double u = rpt->x[i] / rpt->x[nx-1];
+      if ( ny == 0 )
+         rpt->z[i] = 0.9*exp(-2.*u) + 0.05*sin(40.*u);
+      else
+         for ( j=0; j<ny; j++ )
+            rpt->z[i*ny+j] = 0.8*exp(-2.*u*u - 0.3*rpt->y[j]) * (1. + 0.1*cos(25.*u + 3.*rpt->y[j]));
+   }
+   rpt->fname = strdup(label);
+   rpt->scheme = 1;
+   rpt->use_count = -1;
+   rpol_check_equi_range(rpt);
+   return rpt;
+}
+
+static double max_rel_diff (const double *a, const float *b, size_t n, double zmax)
+{
+   double m = 0.;
+   size_t i;
+   for ( i=0; i<n; i++ )
+      if ( fabs(a[i]-b[i]) > m )
+         m = fabs(a[i]-b[i]);
+   return m / zmax;
+}
+
+static void bench (struct rpol_table *rpt, size_t n, double *x, double *y, float *xf, float *yf, 
+   double *r, float *rf)
+{
+   struct rpol_ftable *ft = rpol_compact(rpt, 0);
+   struct rpol_ftable *fti = rpol_compact(rpt, 1);
+   double xmax = rpt->x[rpt->nx-1], ymax = rpt->ndim > 1 ? rpt->y[rpt->ny-1] : 0.;
+   double zmax = 0., t0, t1, t2, t3;
+   size_t i, nz = (rpt->ndim > 1) ? rpt->nx*rpt->ny : rpt->nx;
+   double kb = nz * (rpt->ndim > 1 ? 1. : 2.) / 1024.; /* z (and x for 1-D) values */
+
+   for ( i=0; i<nz; i++ )
+      if ( fabs(rpt->z[i]) > zmax )
+         zmax = fabs(rpt->z[i]);
+   for ( i=0; i<n; i++ )
+   {
+      x[i] = uniform(0., xmax);
+      y[i] = uniform(0., ymax);
+      xf[i] = (float) x[i];
+      yf[i] = (float) y[i];
+   }
+
+   printf("%s (%.0f kB double, %.0f kB float, %sequidistant):\n", rpt->fname, 8.*kb, 4.*kb,
+      (rpt->equidistant == (rpt->ndim > 1 ? 3 : 1)) ? "" : "not ");
+   t0 = now();
+   if ( rpt->ndim == 1 )
+      rpolate_1d_batch(rpt, x, r, n, 1);
+   else
+      rpolate_2d_batch(rpt, x, y, r, n, 1);
+   t1 = now();
+   if ( rpt->ndim == 1 )
+      rpolate_1d_f_batch(ft, xf, rf, n);
+   else
+      rpolate_2d_f_batch(ft, xf, yf, rf, n);
+   t2 = now();
+   printf("   %-12s double %6.2f ns   float %6.2f ns   speed-up %5.2f   max. rel. error %.3g\n",
+      "batch", 1e9*(t1-t0)/n, 1e9*(t2-t1)/n, (t1-t0)/(t2-t1), max_rel_diff(r, rf, n, zmax));
+   if ( rpt->ndim == 1 )
+   {
+      t2 = now();
+      rpolate_1d_f_batch(fti, xf, rf, n);
+      t3 = now();
+      printf("   %-12s double %6.2f ns   float %6.2f ns   speed-up %5.2f   max. rel. error %.3g\n",
+         "interleaved", 1e9*(t1-t0)/n, 1e9*(t3-t2)/n, (t1-t0)/(t3-t2), max_rel_diff(r, rf, n, zmax));
+   }
+
+   t0 = now();
+   for ( i=0; i<n; i++ )
+      r[i] = rpolate(rpt, x[i], y[i], 1);
+   t1 = now();
+   for ( i=0; i<n; i++ )
+      rf[i] = (float) rpolate_f(ft, x[i], y[i]);
+   t2 = now();
+   printf("   %-12s double %6.2f ns   float %6.2f ns   speed-up %5.2f   max. rel. error %.3g\n",
+      "single", 1e9*(t1-t0)/n, 1e9*(t2-t1)/n, (t1-t0)/(t2-t1), max_rel_diff(r, rf, n, zmax));
+
+   rpol_free_compact(ft);
+   rpol_free_compact(fti);
+   rpol_free(rpt, 1);
+}
+
+int main (int argc, char **argv)
+{
+   size_t n = (argc > 1) ? (size_t) atol(argv[1]) : 2000000;
+   double *x = (double *) calloc(n, sizeof(double));
+   double *y = (double *) calloc(n, sizeof(double));
+   double *r = (double *) calloc(n, sizeof(double));
+   float *xf = (float *) calloc(n, sizeof(float));
+   float *yf = (float *) calloc(n, sizeof(float));
+   float *rf = (float *) calloc(n, sizeof(float));
+
+   if ( x == NULL || y == NULL || r == NULL || xf == NULL || yf == NULL || rf == NULL )
+   {
+      fprintf(stderr, "Not enough memory for %zu samples.\n", n);
+      return 1;
+   }
+   srand(12345);
+
+   bench(make_table("1-D 1000", 1000, 0, 0, 0), n, x, y, xf, yf, r, rf);
+   bench(make_table("1-D 100000", 100000, 0, 0, 0), n, x, y, xf, yf, r, rf);
+   bench(make_table("1-D log-spaced 100000", 100000, 0, 1, 0), n, x, y, xf, yf, r, rf);
+   bench(make_table("2-D 100x100", 100, 100, 0, 0), n, x, y, xf, yf, r, rf);
+   bench(make_table("2-D 1000x1000", 1000, 1000, 0, 0), n, x, y, xf, yf, r, rf);
+   bench(make_table("2-D 1000x1000 log-spaced y", 1000, 1000, 0, 1), n, x, y, xf, yf, r, rf);
+
+   return 0;
+}
@@ -10,8 +10,21 @@
 #include "fileopen.h"
 #include "rec_tools.h"
 #include "Tel_groups.h"
+#include "Ground_map.h"
+#include "Hist_defs.h"
+#include "Hist_filler.h"
+#include "Bunch_sort.h"
+#include "TH2F.h"
 #include "TMath.h"
 #include "events.h"
+#include "Camera_pixels.h"
+#include "Hillas.h"
+#include "Atm_trans.h"
+#include "Qe_ref.h"
+#include "mc_atmprof.h"
+#include "atmprof.h"
+#include "Atm_table.h"
+#include <vector>
 /*
     First Version to convert the CORSIKA IACT OUTPUT(bunches) to ROOT
     Author zhangzhipeng
@@ -30,6 +43,7 @@ int main(int argc, char** argv)
     float runh[273], rune[273], evth[273], evte[273];
     int iarray;
     int shower;
+    int run = 0;
     int itel;
     int max_bunches = 50000000;
     int res;
@@ -39,6 +53,54 @@ int main(int argc, char** argv)
     auto photon = new Photon_bunches();
     auto tel_group = new Tel_groups();
     auto event = new events();
+    double zenith = 0.;     // [deg]
+    double energy = 0.;     // [GeV]
+    double gen_index = 0., gen_emin = 0., gen_emax = 0.;    // generated spectrum, for Spectral_weights
+    int camera_rings = 0;
+    double camera_pixel = 0.;
+    Camera_pixels camera;
+    std::vector<std::vector<struct bunch> > tel_bunches;
+    std::vector<std::vector<double> > tel_images;
+    std::vector<float> image;
+    int image_event, image_tel;
+    std::vector<Hillas_parameters> hillas;
+    Hillas_parameters image_hillas;
+    double rec_az, rec_alt, rec_xc, rec_yc, true_az, true_alt, true_xc, true_yc;
+    int rec_status;
+    Atm_trans atm_trans;
+    const char* atm_trans_fname = NULL;
+    std::vector<float> trans;
+    Qe_ref qe_ref;
+    const char* qe_fname = NULL;
+    const char* ref_fname = NULL;
+    std::vector<float> npe;
+    int signal_event, signal_tel;
+    double signal_photons, signal_npe;
+    AtmProf atmprof;
+    Atm_table atm_table;
+    int have_atm = 0;                   // atm_table set up from the file's profile
+    std::vector<double> zem, depth;
+    memset(&atmprof, 0, sizeof(atmprof));
+    int longi_event, longi_type, longi_np, longi_nthick;
+    double longi_step;
+    std::vector<double> longi(12 * 1071);
+    int gmap_bins = 0, gmap_nebins = 0;
+    double gmap_size = 0., gmap_lge_min = 0., gmap_lge_max = 0.;
+    Ground_map gmap;                    // per event
+    std::vector<Ground_map> gmap_e;     // per energy bin
+    Ground_map* gmap_cur = NULL;
+    int gmap_event;
+    double gmap_energy;
+    std::vector<int> gmap_bin;
+    std::vector<float> gmap_photons;
+    int no_bunches = 0;
+    const char* hist_fname = NULL;
+    Hist_filler hist_filler;
+    Spectral_weights spectra;
+    int fill_hists = 0;
+    double tel_area = 0.;
+    int sort_time = 0;
+    Bunch_sort bunch_sort;
     if( ( iobuf = allocate_io_buffer(5000000L)) == NULL)
     {
         std::cout << "Cannot allocate I/O buffer" << std::endl;
@@ -62,12 +124,102 @@ int main(int argc, char** argv)
             argv += 2;
             continue;
         }
+        // ideal hexagonal camera: number of pixel rings and pixel size [deg]
+        else if((strcmp(argv[1], "--camera") == 0) && argc >3)
+        {
+            camera_rings = atoi(argv[2]);
+            camera_pixel = atof(argv[3]);
+            argc -= 3;
+            argv += 3;
+            continue;
+        }
+        // weight each bunch by the atmospheric transmission from an atm_trans_*.dat table
+        else if((strcmp(argv[1], "--atm_trans") == 0) && argc >2)
+        {
+            atm_trans_fname = argv[2];
+            argc -= 2;
+            argv += 2;
+            continue;
+        }
+        // expected photo-electrons with quantum efficiency and mirror reflectivity tables ("none" to skip one)
+        else if((strcmp(argv[1], "--qe_ref") == 0) && argc >3)
+        {
+            qe_fname = argv[2];
+            ref_fname = argv[3];
+            argc -= 3;
+            argv += 3;
+            continue;
+        }
+        // no bunch tree, only the histograms (Draw's h1/h2 or those of --hists)
+        else if((strcmp(argv[1], "--no_bunches") == 0))
+        {
+            no_bunches = 1;
+            argc -= 1;
+            argv += 1;
+            continue;
+        }
+        // bunches of each telescope in the order of their arrival time
+        else if((strcmp(argv[1], "--sort_time") == 0))
+        {
+            sort_time = 1;
+            argc -= 1;
+            argv += 1;
+            continue;
+        }
+        // histogram definitions filled during the conversion, see include/Hist_defs.h
+        else if((strcmp(argv[1], "--hists") == 0) && argc >2)
+        {
+            hist_fname = argv[2];
+            argc -= 2;
+            argv += 2;
+            continue;
+        }
+        // target spectrum name:index[:beta[:e0]] for the event variable "w_<name>" of --hists, as in Draw
+        else if((strcmp(argv[1], "--spectrum") == 0) && argc >2)
+        {
+            if( spectra.add_target(argv[2]) != 0)
+                exit(EXIT_FAILURE);
+            argc -= 2;
+            argv += 2;
+            continue;
+        }
+        // ground-plane photon density: <n> x <n> bins over [-size, size] m around the core
+        else if((strcmp(argv[1], "--ground_map") == 0) && argc >3)
+        {
+            gmap_bins = atoi(argv[2]);
+            gmap_size = atof(argv[3]);
+            argc -= 3;
+            argv += 3;
+            continue;
+        }
+        // ground maps summed in <n> bins of log10(E/GeV) instead of one per event
+        else if((strcmp(argv[1], "--ground_map_ebins") == 0) && argc >4)
+        {
+            gmap_nebins = atoi(argv[2]);
+            gmap_lge_min = atof(argv[3]);
+            gmap_lge_max = atof(argv[4]);
+            argc -= 4;
+            argv += 4;
+            continue;
+        }
         else
         {
             break;
         }
     }
 
+    if( atm_trans_fname != NULL && atm_trans.read(atm_trans_fname) != 0)
+    {
+        std::cout << "Cannot use atmospheric transmission table " << atm_trans_fname << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if( qe_fname != NULL && qe_ref.read(qe_fname, ref_fname) != 0)
+    {
+        std::cout << "Cannot use efficiency tables " << qe_fname << " " << ref_fname << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
     TFile* root_file = new TFile(out_file.c_str(), "RECREATE");
     if( root_file->IsZombie())
     {
@@ -75,13 +227,101 @@ int main(int argc, char** argv)
         exit(1);
     }
 
-    TTree* bunch = new TTree("bunch", "photon_bunches data");
-    bunch->Branch("photon_bunches",&photon);
+    if( no_bunches || hist_fname != NULL)
+    {
+        Hist_defs hist_defs;
+        if( hist_fname != NULL)
+        {
+            if( hist_defs.read(hist_fname) != 0)
+                exit(EXIT_FAILURE);
+        }
+        else
+        {
+            hist_defs.set_default();
+        }
+        if( hist_filler.init(hist_defs, &spectra) != 0)
+            exit(EXIT_FAILURE);
+        fill_hists = 1;
+    }
+
+    TTree* bunch = NULL;
+    if( !no_bunches)
+    {
+        bunch = new TTree("bunch", "photon_bunches data");
+        bunch->Branch("photon_bunches",&photon);
+    }
 
     TTree* event_data = new TTree("event_data", "photons in per tel");
     event_data->Branch("event", &event,500000);
+
+    TTree* signal_data = NULL;
+    if( qe_fname != NULL)
+    {
+        signal_data = new TTree("signal", "expected photo-electrons per tel");
+        signal_data->Branch("event_id", &signal_event);
+        signal_data->Branch("itel", &signal_tel);
+        signal_data->Branch("photons", &signal_photons);
+        signal_data->Branch("npe", &signal_npe);
+    }
+
+    TTree* longi_data = new TTree("longi", "longitudinal distributions from CORSIKA");
+    longi_data->Branch("event_id", &longi_event);
+    longi_data->Branch("type", &longi_type);
+    longi_data->Branch("np", &longi_np);
+    longi_data->Branch("nthick", &longi_nthick);
+    longi_data->Branch("thickstep", &longi_step);
+    longi_data->Branch("data", &longi);
+
+    TTree* image_data = NULL;
+    TTree* reco_data = NULL;
+    if( camera_rings > 0 && camera_pixel > 0.)
+    {
+        camera.set_hex_camera(camera_rings, camera_pixel * TMath::DegToRad());
+        std::cout << "Camera images with " << camera.npix << " pixels of " << camera_pixel << " deg" << std::endl;
+        image_data = new TTree("image", "photons in each pixel");
+        image_data->Branch("event_id", &image_event);
+        image_data->Branch("itel", &image_tel);
+        image_data->Branch("image", &image);
+        image_data->Branch("size", &image_hillas.size);
+        image_data->Branch("cog_x", &image_hillas.cog_x);
+        image_data->Branch("cog_y", &image_hillas.cog_y);
+        image_data->Branch("length", &image_hillas.length);
+        image_data->Branch("width", &image_hillas.width);
+        image_data->Branch("psi", &image_hillas.psi);
+        reco_data = new TTree("reco", "geometric reconstruction from the images");
+        reco_data->Branch("event_id", &image_event);
+        reco_data->Branch("status", &rec_status);
+        reco_data->Branch("az", &rec_az);
+        reco_data->Branch("alt", &rec_alt);
+        reco_data->Branch("xc", &rec_xc);
+        reco_data->Branch("yc", &rec_yc);
+        reco_data->Branch("true_az", &true_az);
+        reco_data->Branch("true_alt", &true_alt);
+        reco_data->Branch("true_xc", &true_xc);
+        reco_data->Branch("true_yc", &true_yc);
+    }
     
 
+    TTree* gmap_data = NULL;
+    if( gmap_bins > 0 && gmap_size > 0.)
+    {
+        if( gmap_nebins > 0 && gmap_lge_max > gmap_lge_min)
+        {
+            gmap_e.resize(gmap_nebins);
+            for( int k = 0; k < gmap_nebins; k++)
+                gmap_e[k].set(gmap_bins, gmap_size);
+        }
+        else
+        {
+            gmap.set(gmap_bins, gmap_size);
+            gmap_data = new TTree("ground_map", "photons per ground bin (iy*n+ix) and event");
+            gmap_data->Branch("event_id", &gmap_event);
+            gmap_data->Branch("energy", &gmap_energy);
+            gmap_data->Branch("bin", &gmap_bin);
+            gmap_data->Branch("photons", &gmap_photons);
+        }
+    }
+
     bunches = (struct bunch *) calloc(max_bunches, sizeof(struct bunch));
 
     //TTree* tel_data = new TTree("tel_data", "some data in each event");
@@ -129,7 +369,10 @@ int main(int argc, char** argv)
             {
                 case IO_TYPE_MC_RUNH:
                     read_tel_block(iobuf, IO_TYPE_MC_RUNH, runh, 273);
-                /* code */
+                    // slope and limits [GeV] of the generated energy spectrum
+                    gen_index = runh[15];
+                    gen_emin = runh[16];
+                    gen_emax = runh[17];
                     break;
 
                 case IO_TYPE_MC_INPUTCFG:
@@ -163,14 +406,26 @@ int main(int argc, char** argv)
                             std::cout << "Problem when reading tel_pos" << std::endl;
                             fflush(stdout);
                          }
+                         tel_group->set_tel_pos();
                          break;
 
                 case IO_TYPE_MC_EVTH:
                     read_tel_block(iobuf, IO_TYPE_MC_EVTH, evth, 273);
                     shower = evth[1];
-                    tel_group->alt = 90. - (180./M_PI)*evth[10];
+                    run = evth[43];
+                    zenith = (180./M_PI)*evth[10];
+                    energy = evth[3];
+                    if( !(gen_emax > gen_emin))
+                    {
+                        // no run header: the same words of the event header
+                        gen_index = evth[57];
+                        gen_emin = evth[58];
+                        gen_emax = evth[59];
+                    }
+                    tel_group->alt = 90. - zenith;
                     tel_group->az  = 180. - (180./M_PI)*(evth[11]-evth[92]);
                     tel_group->az -= floor(tel_group->az/360.) * 360.;
+                    qe_ref.set_bandwidth(evth[95], evth[96]);
                     
                     break;
 
@@ -191,7 +446,22 @@ int main(int argc, char** argv)
                     int jarray;
                     double photons;
                     begin_read_tel_array(iobuf, &item_header, &iarray);
+                    gmap_cur = NULL;
+                    if( gmap_data != NULL)
+                        gmap_cur = &gmap;
+                    else if( !gmap_e.empty() && energy > 0.)
+                    {
+                        int k = (int) floor((log10(energy) - gmap_lge_min) / (gmap_lge_max - gmap_lge_min) * gmap_nebins);
+                        if( k >= 0 && k < gmap_nebins)
+                            gmap_cur = &gmap_e[k];
+                    }
                     sub_item_header.type = IO_TYPE_MC_PHOTONS;
+                    if( image_data != NULL)
+                    {
+                        tel_bunches.resize(tel_group->ntel);
+                        for( int itc = 0; itc < tel_group->ntel; itc++)
+                            tel_bunches[itc].clear();
+                    }
                     for( int itc = 0; itc < tel_group->ntel; itc ++)
                     {
                         if(search_sub_item(iobuf, &item_header, &sub_item_header) < 0)
@@ -203,17 +473,137 @@ int main(int argc, char** argv)
                             fflush(stdout);
                             std::cout << "Error reading"<< std::endl;
                         }
-                           // event->fill(shower*100+jarray, itel, bunches->photons,tel_group->dist[jarray*(tel_group->narray) + itel]);
-                            //event_data->Fill();
-                            //event->clear();
-                            for(int ibunch = 0 ; ibunch < nbunches; ibunch++)
+                        // before everything else, so trans/npe and the tree follow the same order
+                        if( sort_time)
+                        {
+                            bunch_sort.sort_time(bunches, nbunches);
+                        }
+                            event->fill(shower*100+jarray, itel, photons, tel_group->dist[jarray*(tel_group->narray) + itel]);
+                            // telescope sphere radius [m] (collection area in Draw) and zenith angle
+                            if( itel >= 0 && itel < tel_group->ntel)
+                                event->set_rtel(tel_group->rtel[itel] * 0.01);
+                            event->set_zenith(zenith);
+                            event->set_run(run);
+                            event->set_energy(energy);
+                            event->set_generation(gen_index, gen_emin, gen_emax);
+                            event_data->Fill();
+                            if( fill_hists)
+                            {
+                                // as Draw: detection sphere cross-section pi*rtel^2, the old constant without rtel
+                                double r = (event->rtel > 0.) ? event->rtel : 5*cos(10*M_PI/180.);
+                                tel_area = M_PI * r * r;
+                                hist_filler.fill_event(event->run_id, itel, photons, event->rc, event->rtel, zenith, tel_area,
+                                                energy, gen_index, gen_emin, gen_emax, run);
+                            }
+                            event->clear();
+                            if( atm_trans_fname != NULL && nbunches > 0)
+                            {
+                                trans.resize(nbunches);
+                                atm_trans.transmission(bunches, nbunches, 1./cos(zenith*M_PI/180.), trans.data());
+                            }
+                            if( have_atm && nbunches > 0)
+                            {
+                                // slant depth of the emission points, plane-parallel like the airmass above
+                                zem.resize(nbunches);
+                                depth.resize(nbunches);
+                                for( int ib = 0; ib < nbunches; ib++)
+                                    zem[ib] = bunches[ib].zem;
+                                atm_table.thickf(zem.data(), depth.data(), nbunches);
+                                double airmass = 1./cos(zenith*M_PI/180.);
+                                for( int ib = 0; ib < nbunches; ib++)
+                                    depth[ib] *= airmass;
+                            }
+                            if( signal_data != NULL)
+                            {
+                                npe.resize(nbunches);
+                                signal_event = shower*100 + jarray;
+                                signal_tel = itel;
+                                signal_photons = photons;
+                                signal_npe = qe_ref.expected_pe(bunches, nbunches, (uint64_t) signal_event*1000 + itel,
+                                                (atm_trans_fname != NULL) ? trans.data() : NULL, npe.data());
+                                signal_data->Fill();
+                            }
+                            for(int ibunch = 0 ; bunch != NULL && ibunch < nbunches; ibunch++)
                             {
                                 photon->fill_photon_bunch(bunches[ibunch], jarray, itel, tel_group->dist[jarray*(tel_group->narray) + itel]);
+                                if( atm_trans_fname != NULL)
+                                    photon->set_trans(trans[ibunch]);
+                                if( signal_data != NULL)
+                                    photon->set_npe(npe[ibunch]);
+                                if( have_atm)
+                                    photon->set_depth(depth[ibunch]);
                                 bunch->Fill();
                                 photon->clear();
                             }
+                            if( fill_hists)
+                            {
+                                hist_filler.fill_bunches(bunches, nbunches, itel, tel_group->dist[jarray*(tel_group->narray) + itel],
+                                                tel_area, (atm_trans_fname != NULL) ? trans.data() : NULL,
+                                                (signal_data != NULL) ? npe.data() : NULL, have_atm ? depth.data() : NULL);
+                            }
+                            if( image_data != NULL && itel >= 0 && itel < tel_group->ntel)
+                            {
+                                tel_bunches[itel].assign(bunches, bunches + nbunches);
+                            }
+                            // telescope position relative to the core (xoff/yoff are the core in the array frame)
+                            if( gmap_cur != NULL && itel >= 0 && itel < tel_group->ntel)
+                            {
+                                gmap_cur->fill(bunches, nbunches, tel_group->xtel[itel] - tel_group->xoff[jarray],
+                                               tel_group->ytel[itel] - tel_group->yoff[jarray]);
+                            }
                             /* code */
                     }
+                    if( image_data != NULL)
+                    {
+                        int ntel = tel_group->ntel;
+                        std::vector<const Camera_pixels*> cams(ntel, &camera);
+                        std::vector<const struct bunch*> tb(ntel);
+                        std::vector<int> nb(ntel);
+                        std::vector<double*> im(ntel);
+                        tel_images.resize(ntel);
+                        for( int itc = 0; itc < ntel; itc++)
+                        {
+                            tel_images[itc].resize(camera.npix);
+                            tb[itc] = tel_bunches[itc].data();
+                            nb[itc] = tel_bunches[itc].size();
+                            im[itc] = tel_images[itc].data();
+                        }
+                        Camera_pixels::fill_images(ntel, cams.data(), tb.data(), nb.data(), tel_group->az, tel_group->alt, im.data());
+                        hillas.resize(ntel);
+                        std::vector<const double*> cim(im.begin(), im.end());
+                        Hillas_parameters::compute_all(ntel, cams.data(), cim.data(), hillas.data());
+                        image_event = shower*100 + iarray;
+                        for( int itc = 0; itc < ntel; itc++)
+                        {
+                            if( nb[itc] == 0)
+                                continue;
+                            image_tel = itc;
+                            image_hillas = hillas[itc];
+                            image.assign(tel_images[itc].begin(), tel_images[itc].end());
+                            image_data->Fill();
+                        }
+                        rec_az = rec_alt = rec_xc = rec_yc = 0.;
+                        rec_status = Hillas_parameters::reconstruct(ntel, hillas.data(), cams.data(), tel_group->xtel,
+                                        tel_group->ytel, tel_group->ztel, tel_group->az, tel_group->alt, 10.,
+                                        &rec_az, &rec_alt, &rec_xc, &rec_yc);
+                        true_az = tel_group->az;
+                        true_alt = tel_group->alt;
+                        true_xc = tel_group->xoff[iarray];
+                        true_yc = tel_group->yoff[iarray];
+                        reco_data->Fill();
+                    }
+                    if( gmap_cur != NULL)
+                    {
+                        gmap_cur->merge();
+                        if( gmap_data != NULL)
+                        {
+                            gmap_event = shower*100 + iarray;
+                            gmap_energy = energy;
+                            gmap.sparse(gmap_bin, gmap_photons);
+                            gmap_data->Fill();
+                            gmap.clear();
+                        }
+                    }
                                
                     break;
                     
@@ -231,6 +621,64 @@ int main(int argc, char** argv)
                     tel_group->clear();
                     break;
                 
+                // the atmospheric profile used in the simulation, tabulated once per run
+                case IO_TYPE_MC_ATMPROF:
+                    if(read_atmprof(iobuf, &atmprof) < 0)
+                    {
+                        std::cout << "Problem when reading atmospheric profile" << std::endl;
+                        break;
+                    }
+                    have_atm = 0;
+                    if( atmprof.n_alt > 0)
+                    {
+                        init_atmprof_s(&atmprof);
+                        have_atm = (atm_table.build(0) == 0);
+                    }
+                    else if( atmprof.have_lay5_param)
+                    {
+                        // only the 5-layer parametrization, set it up for rhofc/thickc/heighc
+                        int nlay = 5;
+                        atmegs_(&nlay, atmprof.hlay, atmprof.aatm, atmprof.batm, atmprof.catm, atmprof.datm,
+                                &atmprof.htoa);
+                        have_atm = (atm_table.build(1) == 0);
+                    }
+                    else
+                    {
+                        std::cout << "Atmospheric profile " << atmprof.atmprof_id << " has neither a table nor "
+                                  << "5-layer parameters, no slant depths" << std::endl;
+                    }
+                    if( have_atm)
+                    {
+                        atm_table.validate();
+                        std::cout << "Atmospheric profile " << atmprof.atmprof_id << " tabulated, max. rel. error "
+                                  << atm_table.max_rel_err[1] << " (thickness) " << std::endl;
+                    }
+                    if( atm_trans_fname != NULL && fabs(atm_trans.obslev * 1e5 - atmprof.obslev) > 100.)
+                    {
+                        std::cout << "Warning: observation level " << atm_trans.obslev << " km of " << atm_trans_fname
+                                  << " does not match the simulation (" << atmprof.obslev * 1e-5 << " km)" << std::endl;
+                    }
+                    break;
+
+                case IO_TYPE_MC_LONGI:
+                    {
+                        int ndim = 1071;
+                        longi.assign(12 * ndim, 0.);
+                        if(read_shower_longitudinal(iobuf, &longi_event, &longi_type, longi.data(), ndim,
+                                &longi_np, &longi_nthick, &longi_step, 12) < 0)
+                        {
+                            std::cout << "Problem when reading longitudinal distributions" << std::endl;
+                            break;
+                        }
+                        // keep the np profiles back to back, nthick values each
+                        for( int ip = 1; ip < longi_np; ip++)
+                            std::copy(longi.begin() + ip * ndim, longi.begin() + ip * ndim + longi_nthick,
+                                      longi.begin() + ip * longi_nthick);
+                        longi.resize(longi_np * longi_nthick);
+                        longi_data->Fill();
+                    }
+                    break;
+
                 case IO_TYPE_MC_RUNE:
                     read_tel_block(iobuf, IO_TYPE_MC_RUNE, rune, 273);
                     break;
@@ -253,6 +701,33 @@ int main(int argc, char** argv)
 
     }
     event_data->Write();
+    longi_data->Write();
+    if( fill_hists)
+        hist_filler.write();
+    if( signal_data != NULL)
+        signal_data->Write();
+    if( image_data != NULL)
+    {
+        image_data->Write();
+        reco_data->Write();
+    }
+    if( gmap_data != NULL)
+    {
+        gmap_data->Write();
+        // binning of the bins in the ground_map tree
+        TH2F* h = gmap.hist("ground_map_grid", "ground map binning [m]");
+        h->Write();
+        delete h;
+    }
+    for( int k = 0; k < (int) gmap_e.size(); k++)
+    {
+        double lo = gmap_lge_min + k * (gmap_lge_max - gmap_lge_min) / gmap_nebins;
+        double hi = gmap_lge_min + (k + 1) * (gmap_lge_max - gmap_lge_min) / gmap_nebins;
+        std::string title = "photons on the ground [m], log10(E/GeV) " + std::to_string(lo) + " to " + std::to_string(hi);
+        TH2F* h = gmap_e[k].hist(("ground_map_" + std::to_string(k)).c_str(), title.c_str());
+        h->Write();
+        delete h;
+    }
    // tel_data->Write();
     root_file->Write();
     root_file->Close();
@@ -40,8 +40,76 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "initial.h"
 #include "rec_tools.h"
+#include "fast_trig.h"
 #include "io_hess.h"
 
+/* Default for the trigonometric backend, see rec_set_fast_trig(). */
+#ifndef REC_FAST_TRIG
+# define REC_FAST_TRIG 0
+#endif
+
+static int rec_fast_trig = REC_FAST_TRIG;
+
+/* ===================== rec_set_fast_trig ===================== */
+/**
+ *  @short Select libm (0) or the polynomial kernels of fast_trig.h (1).
+ *
+ *  Applies to the per-image geometry: angles_to_offset, offset_to_angles,
+ *  intersect_lines, angle_between, compute_true_dsp, compute_axis_diff
+ *  and the weights in shower_geometric_reconstruction. The default can
+ *  be set at compile time with -DREC_FAST_TRIG=1.
+ *
+ *  @return The previous setting.
+*/
+
+int rec_set_fast_trig (int on)
+{
+   int old = rec_fast_trig;
+   rec_fast_trig = (on != 0);
+   return old;
+}
+
+int rec_get_fast_trig (void)
+{
+   return rec_fast_trig;
+}
+
+static inline void rt_sincos (double x, double *s, double *c)
+{
+   if ( rec_fast_trig )
+      fast_sincos(x, s, c);
+   else
+   {
+      *s = sin(x);
+      *c = cos(x);
+   }
+}
+
+static inline double rt_sin (double x)
+{
+   return rec_fast_trig ? fast_sin(x) : sin(x);
+}
+
+static inline double rt_atan (double x)
+{
+   return rec_fast_trig ? fast_atan(x) : atan(x);
+}
+
+static inline double rt_atan2 (double y, double x)
+{
+   return rec_fast_trig ? fast_atan2(y, x) : atan2(y, x);
+}
+
+static inline double rt_asin (double x)
+{
+   return rec_fast_trig ? fast_asin(x) : asin(x);
+}
+
+static inline double rt_acos (double x)
+{
+   return rec_fast_trig ? fast_acos(x) : acos(x);
+}
+
 /* ------------------- line_point_distance --------------------- */
 /**
  *  Distance between a straight line and a point in space.
@@ -80,6 +148,106 @@ static void rotate_xy (double cam_rot, double *x, double *y)
 }
 #endif
 
+#ifndef POINTING_CACHE_SIZE
+# define POINTING_CACHE_SIZE 16
+#endif
+
+#if defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_THREADS__)
+# define REC_THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+# define REC_THREAD_LOCAL __thread
+#else
+# define REC_THREAD_LOCAL
+#endif
+
+/* Each thread has its own small cache, no locking needed. */
+static REC_THREAD_LOCAL PointingTrans pointing_cache[POINTING_CACHE_SIZE];
+static REC_THREAD_LOCAL int pointing_cache_used = 0;
+static REC_THREAD_LOCAL int pointing_cache_next = 0;
+static REC_THREAD_LOCAL int pointing_cache_last = 0;
+
+static void fill_shower_trans_matrix (double cos_alt, double sin_alt,
+   double cos_az, double sin_az, double trans[][3])
+{
+   double cos_z = sin_alt;
+   double sin_z = cos_alt;
+
+   trans[0][0] = cos_z*cos_az;
+   trans[1][0] = sin_az;
+   trans[2][0] = sin_z*cos_az;
+   
+   trans[0][1] = -cos_z*sin_az;
+   trans[1][1] = cos_az;
+   trans[2][1] = -sin_z*sin_az;
+   
+   trans[0][2] = -sin_z;
+   trans[1][2] = 0.;
+   trans[2][2] = cos_z;
+}
+
+/* ================= get_pointing_trans ================= */
+/**
+ *  @short Look up (or compute and cache) the constants for one pointing.
+ *
+ *  Telescope pointings repeat from one event to the next, so the
+ *  sine/cosine of azimuth and altitude and the shower transformation
+ *  matrix are kept in a small per-thread cache keyed on the exact
+ *  (azimuth, altitude) pair. The cache has POINTING_CACHE_SIZE entries
+ *  with round-robin replacement.
+ *
+ *  @param azimuth   Pointing azimuth [rad].
+ *  @param altitude  Pointing altitude [rad].
+ *
+ *  @return Pointer to the cached entry. It is owned by the calling thread
+ *          and may be replaced by later lookups with other pointings,
+ *          thus use it before looking up the next pointing.
+*/
+
+const PointingTrans *get_pointing_trans (double azimuth, double altitude)
+{
+   PointingTrans *pt = &pointing_cache[pointing_cache_last];
+   int i;
+
+   if ( pointing_cache_used > 0 &&
+        pt->azimuth == azimuth && pt->altitude == altitude )
+      return pt;
+
+   for ( i=0; i<pointing_cache_used; i++ )
+   {
+      pt = &pointing_cache[i];
+      if ( pt->azimuth == azimuth && pt->altitude == altitude )
+      {
+         pointing_cache_last = i;
+         return pt;
+      }
+   }
+
+   i = pointing_cache_next;
+   pointing_cache_next = (pointing_cache_next + 1) % POINTING_CACHE_SIZE;
+   if ( pointing_cache_used < POINTING_CACHE_SIZE )
+      pointing_cache_used++;
+   pointing_cache_last = i;
+
+   pt = &pointing_cache[i];
+   pt->azimuth  = azimuth;
+   pt->altitude = altitude;
+   pt->cos_az   = cos(azimuth);
+   pt->sin_az   = sin(azimuth);
+   pt->cos_alt  = cos(altitude);
+   pt->sin_alt  = sin(altitude);
+   fill_shower_trans_matrix(pt->cos_alt, pt->sin_alt, pt->cos_az, pt->sin_az,
+      pt->trans);
+
+   return pt;
+}
+
+/** Forget all cached pointings of the calling thread. */
+
+void clear_pointing_trans_cache (void)
+{
+   pointing_cache_used = pointing_cache_next = pointing_cache_last = 0;
+}
+
 /* =================== angles_to_offset ====================== */
 /**
  *  @short Transform telescope and object Alt/Az to offset in camera.
@@ -94,15 +262,17 @@ void angles_to_offset (double obj_azimuth, double obj_altitude,
    double azimuth, double altitude, double focal_length, 
    double *xoff, double *yoff)
 {
-   double daz = obj_azimuth - azimuth;
-   double coa = cos(obj_altitude);
+   double sdaz, cdaz, soa, coa;
+   rt_sincos(obj_azimuth - azimuth, &sdaz, &cdaz);
+   rt_sincos(obj_altitude, &soa, &coa);
 
-   double xp0 = -cos(daz) * coa;
-   double yp0 = sin(daz) * coa;
-   double zp0 = sin(obj_altitude);
+   double xp0 = -cdaz * coa;
+   double yp0 = sdaz * coa;
+   double zp0 = soa;
 
-   double cx = sin(altitude);
-   double sx = cos(altitude);
+   const PointingTrans *pt = get_pointing_trans(azimuth, altitude);
+   double cx = pt->sin_alt;
+   double sx = pt->cos_alt;
 
    double xp1 = cx*xp0 + sx*zp0;
    double yp1 = yp0;
@@ -152,22 +322,23 @@ void offset_to_angles (double xoff, double yoff,
    else
    {
       double d = sqrt(xoff*xoff+yoff*yoff);
-      double q = atan(d/focal_length);
+      double q = rt_atan(d/focal_length);
 
-      double sq = sin(q);
+      double sq, zp1;
+      rt_sincos(q, &sq, &zp1);
       double xp1 = xoff * (sq/d);
       double yp1 = yoff * (sq/d);
-      double zp1 = cos(q);
 
-      double cx = sin(altitude);
-      double sx = cos(altitude);
+      const PointingTrans *pt = get_pointing_trans(azimuth, altitude);
+      double cx = pt->sin_alt;
+      double sx = pt->cos_alt;
 
       double xp0 = cx*xp1 - sx*zp1;
       double yp0 = yp1;
       double zp0 = sx*xp1 + cx*zp1;
 
-      *obj_altitude = asin(zp0);
-      *obj_azimuth  = atan2(yp0,-xp0) + azimuth;
+      *obj_altitude = rt_asin(zp0);
+      *obj_azimuth  = rt_atan2(yp0,-xp0) + azimuth;
       if ( *obj_azimuth < 0. )
          *obj_azimuth += 2.*M_PI;
       else if ( *obj_azimuth >= (2.*M_PI ) )
@@ -182,27 +353,18 @@ void offset_to_angles (double xoff, double yoff,
  *  Calculate transformation matrix from horizontal reference
  *  frame to one z axis in the given Az/Alt direction and
  *  the x axis in the plane defined by Az/Alt and zenith.
+ *  The matrix is taken from the pointing cache (see get_pointing_trans()).
 */
 
 void get_shower_trans_matrix (double azimuth, double altitude,
    double trans[][3])
 {
-   double cos_z = sin(altitude);
-   double sin_z = cos(altitude);
-   double cos_az = cos(azimuth);
-   double sin_az = sin(azimuth);
-   
-   trans[0][0] = cos_z*cos_az;
-   trans[1][0] = sin_az;
-   trans[2][0] = sin_z*cos_az;
-   
-   trans[0][1] = -cos_z*sin_az;
-   trans[1][1] = cos_az;
-   trans[2][1] = -sin_z*sin_az;
-   
-   trans[0][2] = -sin_z;
-   trans[1][2] = 0.;
-   trans[2][2] = cos_z;
+   const PointingTrans *pt = get_pointing_trans(azimuth, altitude);
+   int i, j;
+
+   for ( i=0; i<3; i++ )
+      for ( j=0; j<3; j++ )
+         trans[i][j] = pt->trans[i][j];
 }
 
 /* =================== cam_to_ref ====================== */
@@ -266,15 +428,13 @@ int intersect_lines (double xp1, double yp1, double phi1,
    double s1, c1, s2, c2;
    
    /* Hesse normal form for line 1 */
-   s1 = sin(phi1);
-   c1 = cos(phi1);
+   rt_sincos(phi1, &s1, &c1);
    A1 = s1;
    B1 = -c1;
    C1 = yp1*c1 - xp1*s1;
 
    /* Hesse normal form for line 2 */
-   s2 = sin(phi2);
-   c2 = cos(phi2);
+   rt_sincos(phi2, &s2, &c2);
    A2 = s2;
    B2 = -c2;
    C2 = yp2*c2 - xp2*s2;
@@ -320,7 +480,7 @@ int intersect_lines (double xp1, double yp1, double phi1,
          else if ( cos_ang <= -1. )
             *sang = M_PI;
          else
-            *sang = acos(cos_ang);
+            *sang = rt_acos(cos_ang);
       }
    }
    
@@ -448,11 +608,11 @@ int shower_geometric_reconstruction (int ntel,
          /* FIXME: We might also want to use the NSB rates where different
             telescope types are involved. */
          if ( disp != NULL )
-            w = square(amp_red * sin(sa) * disp[itel] * disp[jtel]);
+            w = square(amp_red * rt_sin(sa) * disp[itel] * disp[jtel]);
          else
-            w = square(amp_red * sin(sa));
+            w = square(amp_red * rt_sin(sa));
 #else
-         w = (amp[itel]<amp[jtel]?amp[itel]:amp[jtel]) * sin(sa); /* Old style */
+         w = (amp[itel]<amp[jtel]?amp[itel]:amp[jtel]) * rt_sin(sa); /* Old style */
 #endif
          sum_xs += xs * w;
          sum_xs2+= xs*xs * w;
@@ -521,11 +681,11 @@ int shower_geometric_reconstruction (int ntel,
          amp_red = (amp[itel]*amp[jtel])/(amp[itel]+amp[jtel]);
 #ifdef WT_DISP
          if ( disp != NULL )
-            w = square(amp_red * sin(sa) * disp[itel] * disp[jtel]);
+            w = square(amp_red * rt_sin(sa) * disp[itel] * disp[jtel]);
          else
-            w = square(amp_red * sin(sa));
+            w = square(amp_red * rt_sin(sa));
 #else
-         w = (amp[itel]<amp[jtel]?amp[itel]:amp[jtel]) * sin(sa); /* Old style */
+         w = (amp[itel]<amp[jtel]?amp[itel]:amp[jtel]) * rt_sin(sa); /* Old style */
 #endif
          sum_xs += xs * w;
          sum_xs2+= xs*xs * w;
@@ -572,12 +732,18 @@ int shower_geometric_reconstruction (int ntel,
 
 double angle_between (double azimuth1, double altitude1, double azimuth2, double altitude2)
 {
-   double ax1 = cos(azimuth1)*cos(altitude1);
-   double ay1 = sin(-azimuth1)*cos(altitude1);
-   double az1 = sin(altitude1);
-   double ax2 = cos(azimuth2)*cos(altitude2);
-   double ay2 = sin(-azimuth2)*cos(altitude2);
-   double az2 = sin(altitude2);
+   double saz1, caz1, salt1, calt1;
+   double saz2, caz2, salt2, calt2;
+   rt_sincos(azimuth1, &saz1, &caz1);
+   rt_sincos(altitude1, &salt1, &calt1);
+   rt_sincos(azimuth2, &saz2, &caz2);
+   rt_sincos(altitude2, &salt2, &calt2);
+   double ax1 = caz1*calt1;
+   double ay1 = -saz1*calt1;
+   double az1 = salt1;
+   double ax2 = caz2*calt2;
+   double ay2 = -saz2*calt2;
+   double az2 = salt2;
    double cos_ang = ax1*ax2 + ay1*ay2 + az1*az2;
    /* Check for rounding errors pushing us outside the valid range. */
    if ( cos_ang <= -1. )
@@ -585,7 +751,7 @@ double angle_between (double azimuth1, double altitude1, double azimuth2, double
    else if ( cos_ang >= 1. )
       return 0.;
    else
-      return acos(cos_ang);
+      return rt_acos(cos_ang);
 }
 
 /*double compute_true_dsp(double azimuth, double altitude, double corex, double corey, double tel_x, double tel_y)
@@ -630,29 +796,33 @@ double compute_true_dsp(double azimuth, double altitude, double corex, double co
    double x1,y1,z1;
    double x2,y2,z2;
    double s1 = 1.0, s2 = 2.0;
+   double saz, caz, salt, calt;
+
+   rt_sincos(azimuth, &saz, &caz);
+   rt_sincos(altitude, &salt, &calt);
 
-   x1 = -s1*cos(altitude)*cos(azimuth)+corex;
-   x2 = -s2*cos(altitude)*cos(azimuth)+corex;
+   x1 = -s1*calt*caz+corex;
+   x2 = -s2*calt*caz+corex;
 
-   y1 = s1*cos(altitude)*sin(azimuth)+corey;
-   y2 = s2*cos(altitude)*sin(azimuth)+corey;
+   y1 = s1*calt*saz+corey;
+   y2 = s2*calt*saz+corey;
    
-   z1 = s1*sin(altitude);
-   z2 = s2*sin(altitude);
+   z1 = s1*salt;
+   z2 = s2*salt;
 
    double az1,al1;
    double az2,al2;
 
-   az1 = -atan((y1 - tel_y)/(x1 - tel_x));
-   az2 = -atan((y2 - tel_y)/(x2 - tel_x));
+   az1 = -rt_atan((y1 - tel_y)/(x1 - tel_x));
+   az2 = -rt_atan((y2 - tel_y)/(x2 - tel_x));
 
    //get the distance to the tel position
    double dist1,dist2;
    dist1 = square(x1 - tel_x) + square(y1 - tel_y) + square(z1);
    dist2 = square(x2 - tel_x) + square(y2 - tel_y) + square(z2);
 
-   al1 = asin(z1/sqrt(dist1));
-   al2 = asin(z2/sqrt(dist2));
+   al1 = rt_asin(z1/sqrt(dist1));
+   al2 = rt_asin(z2/sqrt(dist2));
 
    double xoff1, yoff1;
    double xoff2, yoff2;
@@ -661,25 +831,127 @@ double compute_true_dsp(double azimuth, double altitude, double corex, double co
    angles_to_offset(az1, al1, tel_az, tel_al, 1, &xoff1, &yoff1);
    angles_to_offset(az2, al2, tel_az, tel_al, 1, &xoff2, &yoff2);
 
-   double theta = atan((yoff2 - yoff1)/(xoff2 - xoff1));
+   double theta = rt_atan((yoff2 - yoff1)/(xoff2 - xoff1));
 
    return theta;
 }
 
+/* ================== compute_true_dsp_batch ================== */
+/**
+ *  @short compute_true_dsp() for many events and telescopes at once.
+ *
+ *  Same geometry as compute_true_dsp(), but the direction vector of
+ *  the two points on the shower axis, as seen from a telescope, is fed
+ *  into the camera projection without converting it to Az/Alt first.
+ *  The projection is scale invariant, so no trigonometric function
+ *  or square root is needed per telescope. The sine and cosine of the
+ *  shower direction are taken once per event and those of the telescope
+ *  pointings once per call. Events are distributed over threads with
+ *  OpenMP, where available; the loop over telescopes vectorizes.
+ *
+ *  @param nevt     Number of events.
+ *  @param azimuth  Shower azimuth for each event [rad].
+ *  @param altitude Shower altitude for each event [rad].
+ *  @param corex, corey  Core position for each event [m].
+ *  @param ntel     Number of telescopes.
+ *  @param tel_x, tel_y  Telescope positions [m].
+ *  @param tel_az, tel_al  Telescope pointing, same for all nevt events [rad].
+ *  @param theta    Output of size nevt*ntel, element [ievt*ntel+itel]
+ *                  as compute_true_dsp() for that event and telescope.
+ *
+ *  @return 0 on success, -1 for invalid arguments or lack of memory.
+*/
+
+int compute_true_dsp_batch(int nevt, const double *azimuth, const double *altitude,
+   const double *corex, const double *corey,
+   int ntel, const double *tel_x, const double *tel_y,
+   const double *tel_az, const double *tel_al, double *theta)
+{
+   double *tsaz, *tcaz, *tsal, *tcal;
+   int fast = rec_fast_trig;
+   int ievt, itel;
+
+   if ( nevt <= 0 || ntel <= 0 )
+      return ( nevt < 0 || ntel < 0 ) ? -1 : 0;
+
+   if ( (tsaz = (double *) malloc(4*ntel*sizeof(double))) == NULL )
+      return -1;
+   tcaz = tsaz + ntel;
+   tsal = tcaz + ntel;
+   tcal = tsal + ntel;
+   for ( itel=0; itel<ntel; itel++ )
+   {
+      rt_sincos(tel_az[itel], &tsaz[itel], &tcaz[itel]);
+      rt_sincos(tel_al[itel], &tsal[itel], &tcal[itel]);
+   }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) private(itel)
+#endif
+   for ( ievt=0; ievt<nevt; ievt++ )
+   {
+      double saz, caz, salt, calt;
+      double *th = theta + (size_t) ievt * ntel;
+      rt_sincos(azimuth[ievt], &saz, &caz);
+      rt_sincos(altitude[ievt], &salt, &calt);
+
+      /* Points at distance 1 and 2 along the axis, as in compute_true_dsp */
+      double x1 = -calt*caz + corex[ievt], x2 = -2.*calt*caz + corex[ievt];
+      double y1 = calt*saz + corey[ievt],  y2 = 2.*calt*saz + corey[ievt];
+      double z1 = salt, z2 = 2.*salt;
+
+      for ( itel=0; itel<ntel; itel++ )
+      {
+         double dx1 = x1 - tel_x[itel], dy1 = y1 - tel_y[itel];
+         double dx2 = x2 - tel_x[itel], dy2 = y2 - tel_y[itel];
+         /* Azimuth -atan(dy/dx) is folded to cos>=0 like in compute_true_dsp */
+         double ca1 = fabs(dx1), sa1 = -dy1 * copysign(1., dx1);
+         double ca2 = fabs(dx2), sa2 = -dy2 * copysign(1., dx2);
+         /* angles_to_offset with the unnormalized direction */
+         double xp01 = -(ca1*tcaz[itel] + sa1*tsaz[itel]);
+         double yp01 = sa1*tcaz[itel] - ca1*tsaz[itel];
+         double xp02 = -(ca2*tcaz[itel] + sa2*tsaz[itel]);
+         double yp02 = sa2*tcaz[itel] - ca2*tsaz[itel];
+         double xp11 = tsal[itel]*xp01 + tcal[itel]*z1;
+         double zp11 = -tcal[itel]*xp01 + tsal[itel]*z1;
+         double xp12 = tsal[itel]*xp02 + tcal[itel]*z2;
+         double zp12 = -tcal[itel]*xp02 + tsal[itel]*z2;
+         double on1 = (xp11 == 0. && yp01 == 0.) ? 0. : 1.;
+         double on2 = (xp12 == 0. && yp02 == 0.) ? 0. : 1.;
+         double xoff1 = on1 * xp11 / zp11, yoff1 = on1 * yp01 / zp11;
+         double xoff2 = on2 * xp12 / zp12, yoff2 = on2 * yp02 / zp12;
+         th[itel] = (yoff2 - yoff1)/(xoff2 - xoff1);
+      }
+      if ( fast )
+      {
+         for ( itel=0; itel<ntel; itel++ )
+            th[itel] = fast_atan(th[itel]);
+      }
+      else
+      {
+         for ( itel=0; itel<ntel; itel++ )
+            th[itel] = atan(th[itel]);
+      }
+   }
+
+   free(tsaz);
+   return 0;
+}
+
 
 double compute_axis_diff(double ph1, double ph2)
 {
    double x1, x2, y1, y2;
    
-   x1 = cos(ph1), y1 = sin(ph1);
-   x2 = cos(ph2), y2 = sin(ph2);
+   rt_sincos(ph1, &y1, &x1);
+   rt_sincos(ph2, &y2, &x2);
 
    double cos_theta = x1*x2 + y1*y2;
    if(cos_theta<0)
    {
      cos_theta = -cos_theta;
    }
-   double   diff = acos(cos_theta);
+   double   diff = rt_acos(cos_theta);
    assert(diff < 1.6);
    return diff;
 }
\ No newline at end of file